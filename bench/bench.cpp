@@ -0,0 +1,398 @@
+//
+// Benchmarks of the serial and parallel primitives.
+//
+// Prints one JSON object per line:
+//   {"op": "map", "strategy": "Parallel", "container": "vector", "size": 1000,
+//    "element_bytes": 4, "keys": 0, "threads": 4, "repeat": 5,
+//    "latency_ns": {"min": ..., "median": ...}, "items_per_second": ...}
+//
+// Options:
+//   --max-size=N        largest vector input (default 100000000)
+//   --max-node-size=N   largest list/set input (default 1000000)
+//   --threads=1,2,4     thread counts to run Parallel with (default 1 and all cores)
+//   --repeat=N          runs per measurement, the fastest and median are kept (default 5)
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "underscore.hpp"
+
+namespace bench {
+
+    struct Options {
+        size_t max_size = 100000000;
+        size_t max_node_size = 1000000;
+        std::vector<unsigned int> threads;
+        size_t repeat = 5;
+    };
+
+    //  an element of a given size, keyed by its first field.
+    template<size_t Bytes>
+    struct Payload {
+        int key;
+        char pad[Bytes - sizeof(int)];
+
+        Payload() : key(0) {}
+
+        explicit Payload(int key) : key(key) {
+            std::memset(pad, key & 0xff, sizeof(pad));
+        }
+    };
+
+    template<>
+    struct Payload<sizeof(int)> {
+        int key;
+
+        Payload() : key(0) {}
+
+        explicit Payload(int key) : key(key) {}
+    };
+
+    //  keeps the optimizer from dropping results that are never read: the
+    //  empty asm may read all of memory through &value.
+    template<typename T>
+    void consume(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        volatile const char *bytes = reinterpret_cast<volatile const char *>(&value);
+        volatile char first = bytes[0];
+        (void) first;
+#endif
+    }
+
+    struct Case {
+        std::string op;
+        std::string strategy;
+        std::string container;
+        size_t size;
+        size_t element_bytes;
+        size_t keys;
+        unsigned int threads;
+    };
+
+    class Runner {
+    public:
+        explicit Runner(const Options &options) : options(options) {}
+
+        template<typename Function>
+        void run(const Case &c, Function function) {
+            std::vector<double> latencies;
+            for (size_t i = 0; i < options.repeat; i++) {
+                auto start = std::chrono::steady_clock::now();
+                function();
+                auto end = std::chrono::steady_clock::now();
+                latencies.push_back((double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            }
+            std::sort(latencies.begin(), latencies.end());
+            double min = latencies.front();
+            double median = latencies[latencies.size() / 2];
+
+            std::ostringstream out;
+            out << "{\"op\": \"" << c.op << "\", \"strategy\": \"" << c.strategy
+                << "\", \"container\": \"" << c.container << "\", \"size\": " << c.size
+                << ", \"element_bytes\": " << c.element_bytes << ", \"keys\": " << c.keys
+                << ", \"threads\": " << c.threads << ", \"repeat\": " << options.repeat
+                << ", \"latency_ns\": {\"min\": " << (long long) min << ", \"median\": " << (long long) median
+                << "}, \"items_per_second\": " << (min > 0 ? c.size * 1e9 / min : 0) << "}";
+            std::cout << out.str() << std::endl;
+        }
+
+    private:
+        const Options &options;
+    };
+
+    template<typename Strategy>
+    struct Name;
+
+    template<>
+    struct Name<_::Serial> {
+        static const char *value() { return "Serial"; }
+    };
+
+    template<>
+    struct Name<_::Parallel> {
+        static const char *value() { return "Parallel"; }
+    };
+
+    std::vector<size_t> key_counts(size_t size) {
+        std::vector<size_t> result;
+        for (size_t keys : {(size_t) 10, (size_t) 1000, (size_t) 1000000}) {
+            if (keys <= size) {
+                result.push_back(keys);
+            }
+        }
+        return result;
+    }
+
+    //  each, map, filter, group, countBy, reduce and chains over a vector.
+    template<typename Strategy, size_t Bytes>
+    void vector_suite(Runner &runner, size_t size, unsigned int threads) {
+        using value_type = Payload<Bytes>;
+        std::vector<value_type> a;
+        a.reserve(size);
+        for (size_t i = 0; i < size; i++) {
+            a.push_back(value_type((int) i));
+        }
+        Case c{"", Name<Strategy>::value(), "vector", size, Bytes, 0, threads};
+
+        c.op = "each";
+        runner.run(c, [&a]() {
+            std::atomic<long long> sum{0};
+            Strategy::each(a, [&sum](const value_type &item) {
+                if (item.key < 0) {
+                    sum.fetch_add(item.key);
+                }
+            });
+            consume(sum);
+        });
+
+        c.op = "map";
+        runner.run(c, [&a]() {
+            auto result = Strategy::template map<std::vector<int>>(a, [](const value_type &item) -> int {
+                return item.key * 2;
+            });
+            consume(result);
+        });
+
+        c.op = "filter";
+        runner.run(c, [&a]() {
+            auto result = Strategy::filter(a, [](const value_type &item) -> bool { return item.key % 2 == 0; });
+            consume(result);
+        });
+
+        c.op = "reduce";
+        runner.run(c, [&a]() {
+            auto result = Strategy::reduce(a, [](long long memo, const value_type &item) -> long long {
+                return memo + item.key;
+            }, 0LL, [](long long left, long long right) -> long long { return left + right; });
+            consume(result);
+        });
+
+        c.op = "sortBy";
+        runner.run(c, [&a]() {
+            //  descending keys, so the input is not already sorted
+            auto result = Strategy::sortBy(a, [](const value_type &item) -> int { return -item.key; });
+            consume(result);
+        });
+
+        c.op = "topK";
+        runner.run(c, [&a]() {
+            auto result = Strategy::topK(a, 100, [](const value_type &left, const value_type &right) -> bool {
+                return left.key > right.key;
+            });
+            consume(result);
+        });
+
+        for (size_t keys : key_counts(size)) {
+            c.keys = keys;
+            c.op = "group";
+            runner.run(c, [&a, keys]() {
+                auto result = Strategy::template group<int>(a, [keys](const value_type &item) -> int {
+                    return (int) (item.key % keys);
+                });
+                consume(result);
+            });
+
+            c.op = "countBy";
+            runner.run(c, [&a, keys]() {
+                auto result = Strategy::template countBy<int>(a, [keys](const value_type &item) -> int {
+                    return (int) (item.key % keys);
+                });
+                consume(result);
+            });
+        }
+        c.keys = 0;
+
+        c.op = "chain";
+        runner.run(c, [&a]() {
+            auto result = _::chain<Strategy>(a)
+                    .template map<std::vector<long long>>([](const value_type &item) -> long long {
+                        return item.key * 3LL;
+                    })
+                    .filter([](const long long &item) -> bool { return item % 2 == 0; })
+                    .reduce([](long long memo, long long item) -> long long { return memo + item; }, 0LL,
+                            [](long long left, long long right) -> long long { return left + right; })
+                    .value();
+            consume(result);
+        });
+
+        c.op = "lazy_chain";
+        runner.run(c, [&a]() {
+            auto result = _::lazy<Strategy>(a)
+                    .template map<std::vector<long long>>([](const value_type &item) -> long long {
+                        return item.key * 3LL;
+                    })
+                    .filter([](const long long &item) -> bool { return item % 2 == 0; })
+                    .reduce([](long long memo, long long item) -> long long { return memo + item; }, 0LL,
+                            [](long long left, long long right) -> long long { return left + right; })
+                    .value();
+            consume(result);
+        });
+    }
+
+    template<typename Strategy>
+    void flatten_suite(Runner &runner, size_t size, unsigned int threads) {
+        //  inner vectors of 1 to 64 elements
+        std::vector<std::vector<int>> a;
+        size_t total = 0;
+        for (size_t i = 0; total < size; i++) {
+            size_t inner = std::min<size_t>(1 + i % 64, size - total);
+            a.push_back(std::vector<int>(inner, (int) i));
+            total += inner;
+        }
+        Case c{"flatten", Name<Strategy>::value(), "vector", size, sizeof(int), 0, threads};
+        runner.run(c, [&a]() {
+            auto result = Strategy::flatten(a);
+            consume(result);
+        });
+    }
+
+    template<typename Strategy>
+    void list_suite(Runner &runner, size_t size, unsigned int threads) {
+        std::list<int> a;
+        for (size_t i = 0; i < size; i++) {
+            a.push_back((int) i);
+        }
+        Case c{"", Name<Strategy>::value(), "list", size, sizeof(int), 0, threads};
+
+        c.op = "map";
+        runner.run(c, [&a]() {
+            auto result = Strategy::template map<std::vector<int>>(a, [](const int &item) -> int {
+                return item * 2;
+            });
+            consume(result);
+        });
+
+        c.op = "filter";
+        runner.run(c, [&a]() {
+            auto result = Strategy::filter(a, [](const int &item) -> bool { return item % 2 == 0; });
+            consume(result);
+        });
+
+        c.op = "reduce";
+        runner.run(c, [&a]() {
+            auto result = Strategy::reduce(a, [](long long memo, const int &item) -> long long {
+                return memo + item;
+            }, 0LL, [](long long left, long long right) -> long long { return left + right; });
+            consume(result);
+        });
+
+        for (size_t keys : key_counts(size)) {
+            c.keys = keys;
+            c.op = "group";
+            runner.run(c, [&a, keys]() {
+                auto result = Strategy::template group<int>(a, [keys](const int &item) -> int {
+                    return (int) (item % keys);
+                });
+                consume(result);
+            });
+        }
+    }
+
+    template<typename Strategy>
+    void set_suite(Runner &runner, size_t size, unsigned int threads) {
+        std::set<int> a;
+        for (size_t i = 0; i < size; i++) {
+            a.insert((int) i);
+        }
+        Case c{"", Name<Strategy>::value(), "set", size, sizeof(int), 0, threads};
+
+        c.op = "map";
+        runner.run(c, [&a]() {
+            auto result = Strategy::template map<std::vector<int>>(a, [](const int &item) -> int {
+                return item * 2;
+            });
+            consume(result);
+        });
+
+        c.op = "reduce";
+        runner.run(c, [&a]() {
+            auto result = Strategy::reduce(a, [](long long memo, const int &item) -> long long {
+                return memo + item;
+            }, 0LL, [](long long left, long long right) -> long long { return left + right; });
+            consume(result);
+        });
+
+        for (size_t keys : key_counts(size)) {
+            c.keys = keys;
+            c.op = "countBy";
+            runner.run(c, [&a, keys]() {
+                auto result = Strategy::template countBy<int>(a, [keys](const int &item) -> int {
+                    return (int) (item % keys);
+                });
+                consume(result);
+            });
+        }
+    }
+
+    template<typename Strategy>
+    void suite(Runner &runner, const Options &options, unsigned int threads) {
+        for (size_t size = 10; size <= options.max_size; size *= 10) {
+            vector_suite<Strategy, 4>(runner, size, threads);
+            if (size <= options.max_size / 16) {
+                vector_suite<Strategy, 64>(runner, size, threads);
+            }
+            flatten_suite<Strategy>(runner, size, threads);
+            if (size <= options.max_node_size) {
+                list_suite<Strategy>(runner, size, threads);
+                set_suite<Strategy>(runner, size, threads);
+            }
+        }
+    }
+
+    Options parse(int argc, char **argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            std::string value = arg.substr(arg.find('=') + 1);
+            if (arg.find("--max-size=") == 0) {
+                options.max_size = (size_t) std::strtod(value.c_str(), nullptr);
+            } else if (arg.find("--max-node-size=") == 0) {
+                options.max_node_size = (size_t) std::strtod(value.c_str(), nullptr);
+            } else if (arg.find("--repeat=") == 0) {
+                options.repeat = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+            } else if (arg.find("--threads=") == 0) {
+                std::istringstream in(value);
+                std::string item;
+                while (std::getline(in, item, ',')) {
+                    options.threads.push_back((unsigned int) std::max(1ul, std::strtoul(item.c_str(), nullptr, 10)));
+                }
+            } else {
+                std::cerr << "unknown option " << arg << std::endl;
+                std::exit(1);
+            }
+        }
+        if (options.threads.empty()) {
+            options.threads.push_back(1);
+            unsigned int cores = std::thread::hardware_concurrency();
+            if (cores > 1) {
+                options.threads.push_back(cores);
+            }
+        }
+        return options;
+    }
+}
+
+int main(int argc, char **argv) {
+
+    auto options = bench::parse(argc, argv);
+    bench::Runner runner(options);
+
+    bench::suite<_::Serial>(runner, options, 1);
+    for (unsigned int threads : options.threads) {
+        //  the calling thread works too, so the pool needs one thread less
+        _::parallel::thread_pool pool(threads - 1);
+        _::parallel::scoped_pool scope(pool);
+        bench::suite<_::Parallel>(runner, options, threads);
+    }
+
+    return 0;
+}
@@ -6,442 +6,4648 @@
 #define UNDERSCOREPP_UNDERSCORE_HPP
 
 #include <map>
-#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <tuple>
+#include <vector>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <exception>
+#include <limits>
 #include <algorithm>
+#include <type_traits>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <future>
+#include <cstddef>
+#include <iterator>
+#include <istream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #undef min
 #undef max
 
-namespace _ {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(UNDERSCORE_NO_SIMD)
+#define UNDERSCORE_SIMD_X86
+#include <immintrin.h>
+#define UNDERSCORE_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace _ {
+
+    //  elementwise arithmetic with a constant. map() over a vector of
+    //  numbers runs these through the simd kernels below.
+    namespace ops {
+
+        struct _add {
+            template<typename T>
+            static T apply(T item, T value) { return item + value; }
+        };
+
+        struct _subtract {
+            template<typename T>
+            static T apply(T item, T value) { return item - value; }
+        };
+
+        struct _multiply {
+            template<typename T>
+            static T apply(T item, T value) { return item * value; }
+        };
+
+        //  items of another type are combined with value in their common
+        //  type and converted back, so doubles plus add(2) keep their
+        //  fractions. only items of type T take the simd kernels.
+        template<typename Kind, typename T>
+        struct elementwise {
+            T value;
+
+            template<typename Item>
+            Item operator()(const Item &item) const {
+                using common_type = typename std::common_type<Item, T>::type;
+                return static_cast<Item>(Kind::template apply<common_type>(item, value));
+            }
+        };
+
+        template<typename T>
+        elementwise<_add, T> add(T value) {
+            return elementwise<_add, T>{value};
+        }
+
+        template<typename T>
+        elementwise<_subtract, T> subtract(T value) {
+            return elementwise<_subtract, T>{value};
+        }
+
+        template<typename T>
+        elementwise<_multiply, T> multiply(T value) {
+            return elementwise<_multiply, T>{value};
+        }
+    }
+
+    //  kernels over contiguous numbers. the portable versions keep LANES
+    //  independent accumulators so the compiler can vectorize them; float,
+    //  double and int additionally get AVX2 versions picked at runtime.
+    namespace simd {
+
+        //  integers are summed as long long, so large inputs do not overflow.
+        template<typename T>
+        struct sum_type {
+            using type = typename std::conditional<std::is_integral<T>::value, long long, T>::type;
+        };
+
+        const size_t LANES = 8;
+
+        template<typename T>
+        typename sum_type<T>::type _sum(const T *data, size_t size) {
+            using result_type = typename sum_type<T>::type;
+            result_type lanes[LANES] = {};
+            size_t i = 0;
+            for (; i + LANES <= size; i += LANES) {
+                for (size_t j = 0; j < LANES; j++) {
+                    lanes[j] += data[i + j];
+                }
+            }
+            for (; i < size; i++) {
+                lanes[0] += data[i];
+            }
+            result_type result = result_type();
+            for (size_t j = 0; j < LANES; j++) {
+                result += lanes[j];
+            }
+            return result;
+        }
+
+        template<bool Max, typename T>
+        T _extreme(const T *data, size_t size) {
+            if (size == 0) {
+                return Max ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max();
+            }
+            T lanes[LANES];
+            std::fill(lanes, lanes + LANES, data[0]);
+            size_t i = 0;
+            for (; i + LANES <= size; i += LANES) {
+                for (size_t j = 0; j < LANES; j++) {
+                    lanes[j] = (Max ? data[i + j] > lanes[j] : data[i + j] < lanes[j]) ? data[i + j] : lanes[j];
+                }
+            }
+            for (; i < size; i++) {
+                lanes[0] = (Max ? data[i] > lanes[0] : data[i] < lanes[0]) ? data[i] : lanes[0];
+            }
+            T result = lanes[0];
+            for (size_t j = 1; j < LANES; j++) {
+                result = (Max ? lanes[j] > result : lanes[j] < result) ? lanes[j] : result;
+            }
+            return result;
+        }
+
+        template<typename T>
+        typename sum_type<T>::type _dot(const T *left, const T *right, size_t size) {
+            using result_type = typename sum_type<T>::type;
+            result_type lanes[LANES] = {};
+            size_t i = 0;
+            for (; i + LANES <= size; i += LANES) {
+                for (size_t j = 0; j < LANES; j++) {
+                    lanes[j] += (result_type) left[i + j] * right[i + j];
+                }
+            }
+            for (; i < size; i++) {
+                lanes[0] += (result_type) left[i] * right[i];
+            }
+            result_type result = result_type();
+            for (size_t j = 0; j < LANES; j++) {
+                result += lanes[j];
+            }
+            return result;
+        }
+
+        template<typename Kind, typename T>
+        void _apply(const T *input, T *output, size_t size, T value) {
+            for (size_t i = 0; i < size; i++) {
+                output[i] = Kind::apply(input[i], value);
+            }
+        }
+
+        template<typename T>
+        struct _kernels {
+            static typename sum_type<T>::type sum(const T *data, size_t size) {
+                return _sum(data, size);
+            }
+
+            static T min(const T *data, size_t size) {
+                return _extreme<false>(data, size);
+            }
+
+            static T max(const T *data, size_t size) {
+                return _extreme<true>(data, size);
+            }
+
+            static typename sum_type<T>::type dot(const T *left, const T *right, size_t size) {
+                return _dot(left, right, size);
+            }
+
+            template<typename Kind>
+            static void apply(const T *input, T *output, size_t size, T value) {
+                _apply<Kind>(input, output, size, value);
+            }
+        };
+
+#ifdef UNDERSCORE_SIMD_X86
+
+        inline bool has_avx2() {
+            static const bool result = []() {
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") != 0;
+            }();
+            return result;
+        }
+
+        struct _avx2_ps {
+            using value_type = float;
+            using reg = __m256;
+            static const size_t width = 8;
+
+            UNDERSCORE_AVX2 static reg load(const float *data) { return _mm256_loadu_ps(data); }
+
+            UNDERSCORE_AVX2 static void store(float *data, reg value) { _mm256_storeu_ps(data, value); }
+
+            UNDERSCORE_AVX2 static reg set1(float value) { return _mm256_set1_ps(value); }
+
+            UNDERSCORE_AVX2 static reg add(reg left, reg right) { return _mm256_add_ps(left, right); }
+
+            UNDERSCORE_AVX2 static reg mul(reg left, reg right) { return _mm256_mul_ps(left, right); }
+
+            UNDERSCORE_AVX2 static reg min(reg left, reg right) { return _mm256_min_ps(left, right); }
+
+            UNDERSCORE_AVX2 static reg max(reg left, reg right) { return _mm256_max_ps(left, right); }
+        };
+
+        struct _avx2_pd {
+            using value_type = double;
+            using reg = __m256d;
+            static const size_t width = 4;
+
+            UNDERSCORE_AVX2 static reg load(const double *data) { return _mm256_loadu_pd(data); }
+
+            UNDERSCORE_AVX2 static void store(double *data, reg value) { _mm256_storeu_pd(data, value); }
+
+            UNDERSCORE_AVX2 static reg set1(double value) { return _mm256_set1_pd(value); }
+
+            UNDERSCORE_AVX2 static reg add(reg left, reg right) { return _mm256_add_pd(left, right); }
+
+            UNDERSCORE_AVX2 static reg mul(reg left, reg right) { return _mm256_mul_pd(left, right); }
+
+            UNDERSCORE_AVX2 static reg min(reg left, reg right) { return _mm256_min_pd(left, right); }
+
+            UNDERSCORE_AVX2 static reg max(reg left, reg right) { return _mm256_max_pd(left, right); }
+        };
+
+        struct _avx2_epi32 {
+            using value_type = int;
+            using reg = __m256i;
+            static const size_t width = 8;
+
+            UNDERSCORE_AVX2 static reg load(const int *data) {
+                return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+            }
+
+            UNDERSCORE_AVX2 static void store(int *data, reg value) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), value);
+            }
+
+            UNDERSCORE_AVX2 static reg min(reg left, reg right) { return _mm256_min_epi32(left, right); }
+
+            UNDERSCORE_AVX2 static reg max(reg left, reg right) { return _mm256_max_epi32(left, right); }
+        };
+
+        //  two accumulators per kernel hide the latency of the adds.
+        template<typename V>
+        UNDERSCORE_AVX2 typename V::value_type _avx2_sum(const typename V::value_type *data, size_t size) {
+            using T = typename V::value_type;
+            typename V::reg acc0 = V::set1(0), acc1 = V::set1(0);
+            size_t i = 0;
+            for (; i + 2 * V::width <= size; i += 2 * V::width) {
+                acc0 = V::add(acc0, V::load(data + i));
+                acc1 = V::add(acc1, V::load(data + i + V::width));
+            }
+            for (; i + V::width <= size; i += V::width) {
+                acc0 = V::add(acc0, V::load(data + i));
+            }
+            T lanes[V::width];
+            V::store(lanes, V::add(acc0, acc1));
+            T result = 0;
+            for (size_t j = 0; j < V::width; j++) {
+                result += lanes[j];
+            }
+            for (; i < size; i++) {
+                result += data[i];
+            }
+            return result;
+        }
+
+        template<typename V>
+        UNDERSCORE_AVX2 typename V::value_type _avx2_dot(const typename V::value_type *left,
+                                                         const typename V::value_type *right, size_t size) {
+            using T = typename V::value_type;
+            typename V::reg acc0 = V::set1(0), acc1 = V::set1(0);
+            size_t i = 0;
+            for (; i + 2 * V::width <= size; i += 2 * V::width) {
+                acc0 = V::add(acc0, V::mul(V::load(left + i), V::load(right + i)));
+                acc1 = V::add(acc1, V::mul(V::load(left + i + V::width), V::load(right + i + V::width)));
+            }
+            for (; i + V::width <= size; i += V::width) {
+                acc0 = V::add(acc0, V::mul(V::load(left + i), V::load(right + i)));
+            }
+            T lanes[V::width];
+            V::store(lanes, V::add(acc0, acc1));
+            T result = 0;
+            for (size_t j = 0; j < V::width; j++) {
+                result += lanes[j];
+            }
+            for (; i < size; i++) {
+                result += left[i] * right[i];
+            }
+            return result;
+        }
+
+        template<bool Max, typename V>
+        UNDERSCORE_AVX2 typename V::value_type _avx2_extreme(const typename V::value_type *data, size_t size) {
+            using T = typename V::value_type;
+            if (size < V::width) {
+                return _extreme<Max>(data, size);
+            }
+            typename V::reg acc = V::load(data);
+            size_t i = V::width;
+            for (; i + V::width <= size; i += V::width) {
+                acc = Max ? V::max(acc, V::load(data + i)) : V::min(acc, V::load(data + i));
+            }
+            T lanes[V::width];
+            V::store(lanes, acc);
+            T result = _extreme<Max>(lanes, V::width);
+            for (; i < size; i++) {
+                result = (Max ? data[i] > result : data[i] < result) ? data[i] : result;
+            }
+            return result;
+        }
+
+        //  int sums widen to 64 bits lane by lane.
+        UNDERSCORE_AVX2 inline long long _avx2_sum_epi32(const int *data, size_t size) {
+            __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(value)));
+                acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(value, 1)));
+            }
+            long long lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(acc0, acc1));
+            long long result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            for (; i < size; i++) {
+                result += data[i];
+            }
+            return result;
+        }
+
+        //  mul_epi32 multiplies the even lanes into 64 bits; shifting each
+        //  64-bit lane down brings the odd ones into place.
+        UNDERSCORE_AVX2 inline long long _avx2_dot_epi32(const int *left, const int *right, size_t size) {
+            __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(left + i));
+                __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(right + i));
+                acc0 = _mm256_add_epi64(acc0, _mm256_mul_epi32(l, r));
+                acc1 = _mm256_add_epi64(acc1, _mm256_mul_epi32(_mm256_srli_epi64(l, 32), _mm256_srli_epi64(r, 32)));
+            }
+            long long lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(acc0, acc1));
+            long long result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            for (; i < size; i++) {
+                result += (long long) left[i] * right[i];
+            }
+            return result;
+        }
+
+        //  the portable loop, compiled for AVX2.
+        template<typename Kind, typename T>
+        UNDERSCORE_AVX2 void _avx2_apply(const T *input, T *output, size_t size, T value) {
+            for (size_t i = 0; i < size; i++) {
+                output[i] = Kind::apply(input[i], value);
+            }
+        }
+
+        template<typename V>
+        struct _avx2_kernels {
+            using T = typename V::value_type;
+
+            static T sum(const T *data, size_t size) {
+                return has_avx2() ? _avx2_sum<V>(data, size) : _sum(data, size);
+            }
+
+            static T min(const T *data, size_t size) {
+                return has_avx2() ? _avx2_extreme<false, V>(data, size) : _extreme<false>(data, size);
+            }
+
+            static T max(const T *data, size_t size) {
+                return has_avx2() ? _avx2_extreme<true, V>(data, size) : _extreme<true>(data, size);
+            }
+
+            static T dot(const T *left, const T *right, size_t size) {
+                return has_avx2() ? _avx2_dot<V>(left, right, size) : _dot(left, right, size);
+            }
+
+            template<typename Kind>
+            static void apply(const T *input, T *output, size_t size, T value) {
+                if (has_avx2()) {
+                    _avx2_apply<Kind>(input, output, size, value);
+                } else {
+                    _apply<Kind>(input, output, size, value);
+                }
+            }
+        };
+
+        template<>
+        struct _kernels<float> : _avx2_kernels<_avx2_ps> {
+        };
+
+        template<>
+        struct _kernels<double> : _avx2_kernels<_avx2_pd> {
+        };
+
+        template<>
+        struct _kernels<int> {
+            static long long sum(const int *data, size_t size) {
+                return has_avx2() ? _avx2_sum_epi32(data, size) : _sum(data, size);
+            }
+
+            static int min(const int *data, size_t size) {
+                return has_avx2() ? _avx2_extreme<false, _avx2_epi32>(data, size) : _extreme<false>(data, size);
+            }
+
+            static int max(const int *data, size_t size) {
+                return has_avx2() ? _avx2_extreme<true, _avx2_epi32>(data, size) : _extreme<true>(data, size);
+            }
+
+            static long long dot(const int *left, const int *right, size_t size) {
+                return has_avx2() ? _avx2_dot_epi32(left, right, size) : _dot(left, right, size);
+            }
+
+            template<typename Kind>
+            static void apply(const int *input, int *output, size_t size, int value) {
+                if (has_avx2()) {
+                    _avx2_apply<Kind>(input, output, size, value);
+                } else {
+                    _apply<Kind>(input, output, size, value);
+                }
+            }
+        };
+
+#endif
+
+        template<typename T>
+        typename sum_type<T>::type sum(const T *data, size_t size) {
+            return _kernels<T>::sum(data, size);
+        }
+
+        template<typename T>
+        T min(const T *data, size_t size) {
+            return _kernels<T>::min(data, size);
+        }
+
+        template<typename T>
+        T max(const T *data, size_t size) {
+            return _kernels<T>::max(data, size);
+        }
+
+        template<typename T>
+        typename sum_type<T>::type dot(const T *left, const T *right, size_t size) {
+            return _kernels<T>::dot(left, right, size);
+        }
+
+        template<typename Kind, typename T>
+        void apply(const ops::elementwise<Kind, T> &function, const T *input, T *output, size_t size) {
+            _kernels<T>::template apply<Kind>(input, output, size, function.value);
+        }
+    }
+}
+
+namespace _ {
+
+    using namespace std;
+
+    //  the container filter and group collect the items of Container into.
+    //  read-only views, such as mapped_array, collect into a vector.
+    template<typename Container>
+    struct _result_container {
+        using type = Container;
+    };
+
+    template<typename Container>
+    using _collected = typename _result_container<Container>::type;
+
+    template<typename Container, typename Function>
+    void each(const Container &container, Function function) {
+        for (const auto &item : container) {
+            function(item);
+        }
+    };
+
+    template<typename ResultContainer, typename Container, typename Function>
+    ResultContainer map(const Container &container, Function function) {
+        ResultContainer result;
+        for (const auto &item : container) {
+            result.push_back(function(item));
+        }
+        return result;
+    };
+
+    template<typename Container, typename Function>
+    _collected<Container> filter(const Container &container, Function function) {
+        _collected<Container> result;
+        for (const auto &item : container) {
+            if (function(item)) {
+                result.push_back(item);
+            }
+        }
+        return result;
+    };
+
+    //  replaces every element with function(element), without allocating.
+    template<typename Container, typename Function>
+    void transform_inplace(Container &container, Function function) {
+        for (auto &&item : container) {
+            item = function(item);
+        }
+    };
+
+    //  kept items are moved to the front, in order, and the rest is erased.
+    template<typename Container, typename Function>
+    void filter_inplace(Container &container, Function function) {
+        container.erase(std::remove_if(container.begin(), container.end(),
+                                       [&function](const typename Container::value_type &item) -> bool {
+                                           return !function(item);
+                                       }), container.end());
+    };
+
+    //  an rvalue container of the result type is transformed in place and
+    //  handed back, without allocating a new one.
+    template<typename ResultContainer, typename Container, typename Function>
+    typename std::enable_if<std::is_same<ResultContainer, Container>::value, ResultContainer>::type
+    map(Container &&container, Function function) {
+        transform_inplace(container, function);
+        return std::move(container);
+    };
+
+    template<typename Container, typename Function>
+    typename std::enable_if<!std::is_reference<Container>::value &&
+                            std::is_same<_collected<Container>, Container>::value, Container>::type
+    filter(Container &&container, Function function) {
+        filter_inplace(container, function);
+        return std::move(container);
+    };
+
+    //  Map is the kind of map returned, e.g. std::map or std::unordered_map.
+    template<typename GroupKey, template<typename...> class Map, typename Container, typename Function>
+    Map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+        Map<GroupKey, _collected<Container>> result;
+        _::each(container, [&result, &function](const typename Container::value_type &item) {
+            GroupKey key = function(item);
+            result[key].push_back(item);
+        });
+        return result;
+    };
+
+    template<typename GroupKey, typename Container, typename Function>
+    std::map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+        return group<GroupKey, std::map>(container, function);
+    };
+
+    //  leaves trivial values uninitialized when a container is sized, e.g.
+    //  std::vector<int, _::default_init_allocator<int>> result(n). parallel
+    //  map and flatten then touch each page of the result first from the
+    //  thread that writes it, which places it on that thread's NUMA node.
+    template<typename T, typename Allocator = std::allocator<T>>
+    class default_init_allocator : public Allocator {
+
+        using traits = std::allocator_traits<Allocator>;
+
+    public:
+        template<typename U>
+        struct rebind {
+            using other = default_init_allocator<U, typename traits::template rebind_alloc<U>>;
+        };
+
+        using Allocator::Allocator;
+
+        default_init_allocator() = default;
+
+        template<typename U>
+        void construct(U *ptr) {
+            ::new(static_cast<void *>(ptr)) U;
+        }
+
+        template<typename U, typename... Args>
+        void construct(U *ptr, Args &&... args) {
+            traits::construct(static_cast<Allocator &>(*this), ptr, std::forward<Args>(args)...);
+        }
+    };
+
+    //  the arena and mapped types live in their own namespace, so containers
+    //  that use them do not bring the serial primitives into argument
+    //  dependent lookup from _::parallel.
+    namespace memory {
+
+        //  monotonic memory: allocations bump an offset through blocks that
+        //  double in size, and are never freed one by one. release() drops all
+        //  of them at once and keeps the largest block for the next batch.
+        //  allocate may be called from several threads, release may not.
+        class arena {
+        public:
+            explicit arena(size_t block_size = 1 << 16) : block_size(std::max<size_t>(block_size, 64)) {}
+
+            arena(const arena &) = delete;
+
+            arena &operator=(const arena &) = delete;
+
+            ~arena() {
+                _free(head.load());
+            }
+
+            void *allocate(size_t bytes, size_t align) {
+                while (true) {
+                    block *current = head.load(std::memory_order_acquire);
+                    if (current != nullptr) {
+                        const size_t base = reinterpret_cast<size_t>(current->data());
+                        size_t used = current->used.load(std::memory_order_relaxed);
+                        while (true) {
+                            size_t start = ((base + used + align - 1) & ~(align - 1)) - base;
+                            if (start + bytes > current->size) {
+                                break;
+                            }
+                            if (current->used.compare_exchange_weak(used, start + bytes)) {
+                                return current->data() + start;
+                            }
+                        }
+                    }
+                    _grow(current, bytes + align);
+                }
+            }
+
+            //  everything allocated from the arena must be destroyed first.
+            void release() {
+                block *current = head.load();
+                if (current != nullptr) {
+                    _free(current->next);
+                    current->next = nullptr;
+                    current->used.store(0);
+                }
+            }
+
+        private:
+            struct block {
+                block *next;
+                size_t size;
+                std::atomic<size_t> used;
+
+                char *data() {
+                    return reinterpret_cast<char *>(this) + header();
+                }
+
+                static size_t header() {
+                    const size_t align = alignof(std::max_align_t);
+                    return (sizeof(block) + align - 1) / align * align;
+                }
+            };
+
+            //  adds a block unless another thread already replaced seen.
+            void _grow(block *seen, size_t bytes) {
+                std::lock_guard<std::mutex> guard(_mutex);
+                if (head.load() != seen) {
+                    return;
+                }
+                size_t size = std::max(bytes, seen == nullptr ? block_size : seen->size * 2);
+                block *grown = static_cast<block *>(::operator new(block::header() + size));
+                grown->next = seen;
+                grown->size = size;
+                grown->used.store(0);
+                head.store(grown, std::memory_order_release);
+            }
+
+            static void _free(block *first) {
+                while (first != nullptr) {
+                    block *next = first->next;
+                    ::operator delete(first);
+                    first = next;
+                }
+            }
+
+            const size_t block_size;
+            std::atomic<block *> head{nullptr};
+            std::mutex _mutex;
+        };
+
+        inline arena *&_current_arena() {
+            static thread_local arena *current = nullptr;
+            return current;
+        }
+
+        //  makes an arena the one default constructed arena_allocators use on
+        //  this thread, until the end of the scope. parallel primitives hand it
+        //  on to the threads that run their chunks.
+        class scoped_arena {
+        public:
+            explicit scoped_arena(arena *scope) : previous(_current_arena()) {
+                _current_arena() = scope;
+            }
+
+            explicit scoped_arena(arena &scope) : scoped_arena(&scope) {}
+
+            scoped_arena(const scoped_arena &) = delete;
+
+            scoped_arena &operator=(const scoped_arena &) = delete;
+
+            ~scoped_arena() {
+                _current_arena() = previous;
+            }
+
+        private:
+            arena *previous;
+        };
+
+        //  allocates from an arena, by default the one in scope when the
+        //  allocator is made; without one it falls back to operator new.
+        //  deallocate only frees what operator new gave.
+        template<typename T>
+        class arena_allocator {
+        public:
+            using value_type = T;
+
+            arena_allocator() : source(_current_arena()) {}
+
+            explicit arena_allocator(arena *source) : source(source) {}
+
+            template<typename U>
+            arena_allocator(const arena_allocator<U> &other) : source(other.source) {}
+
+            T *allocate(size_t n) {
+                if (source == nullptr) {
+                    return static_cast<T *>(::operator new(n * sizeof(T)));
+                }
+                return static_cast<T *>(source->allocate(n * sizeof(T), alignof(T)));
+            }
+
+            void deallocate(T *ptr, size_t n) {
+                if (source == nullptr) {
+                    ::operator delete(ptr);
+                }
+            }
+
+            template<typename U>
+            bool operator==(const arena_allocator<U> &other) const {
+                return source == other.source;
+            }
+
+            template<typename U>
+            bool operator!=(const arena_allocator<U> &other) const {
+                return source != other.source;
+            }
+
+        private:
+            template<typename U>
+            friend class arena_allocator;
+
+            arena *source;
+        };
+    }
+
+    using memory::arena;
+    using memory::_current_arena;
+    using memory::scoped_arena;
+    using memory::arena_allocator;
+
+    //  containers backed by the arena in scope, e.g.
+    //  _::parallel::group<int, _::arena_unordered_map>(items, key).
+    template<typename T>
+    using arena_vector = std::vector<T, arena_allocator<T>>;
+
+    template<typename Key, typename T>
+    using arena_map = std::map<Key, T, std::less<Key>, arena_allocator<std::pair<const Key, T>>>;
+
+    template<typename Key, typename T>
+    using arena_unordered_map = std::unordered_map<Key, T, std::hash<Key>, std::equal_to<Key>,
+            arena_allocator<std::pair<const Key, T>>>;
+
+    template<typename Key>
+    using arena_unordered_set = std::unordered_set<Key, std::hash<Key>, std::equal_to<Key>, arena_allocator<Key>>;
+
+    namespace memory {
+
+        //  a read-only view of a file of T records. on linux the file is
+        //  mapped instead of read, so primitives run straight over the page
+        //  cache; elsewhere it is read into memory. copies share the mapping.
+        //  trailing bytes that do not fill a record are ignored.
+        template<typename T>
+        class mapped_array {
+
+            static_assert(std::is_trivially_copyable<T>::value, "mapped_array needs trivially copyable records");
+
+        public:
+            using value_type = T;
+            using size_type = size_t;
+            using difference_type = std::ptrdiff_t;
+            using reference = const T &;
+            using const_reference = const T &;
+            using pointer = const T *;
+            using const_pointer = const T *;
+            using iterator = const T *;
+            using const_iterator = const T *;
+
+            //  how the records will be read, see madvise(2).
+            enum ADVICE {
+                NORMAL, SEQUENTIAL, RANDOM, WILLNEED
+            };
+
+            explicit mapped_array(const std::string &path, ADVICE advice = SEQUENTIAL) : items(nullptr), count(0) {
+#ifdef __linux__
+                int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                struct stat info;
+                if (fd < 0 || ::fstat(fd, &info) != 0) {
+                    if (fd >= 0) {
+                        ::close(fd);
+                    }
+                    throw std::runtime_error("underscore: cannot open " + path);
+                }
+                const size_t bytes = (size_t) info.st_size;
+                if (bytes >= sizeof(T)) {
+                    void *memory = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+                    if (memory == MAP_FAILED) {
+                        ::close(fd);
+                        throw std::runtime_error("underscore: cannot map " + path);
+                    }
+                    mapping = std::shared_ptr<const void>(memory, [bytes](const void *memory) {
+                        ::munmap(const_cast<void *>(memory), bytes);
+                    });
+                    items = static_cast<const T *>(memory);
+                    count = bytes / sizeof(T);
+                }
+                ::close(fd);
+                advise(advice);
+#else
+                std::ifstream in(path, std::ios::binary | std::ios::ate);
+                if (!in) {
+                    throw std::runtime_error("underscore: cannot open " + path);
+                }
+                count = (size_t) in.tellg() / sizeof(T);
+                std::shared_ptr<char> buffer(new char[count * sizeof(T) + 1], std::default_delete<char[]>());
+                in.seekg(0);
+                in.read(buffer.get(), count * sizeof(T));
+                items = reinterpret_cast<const T *>(buffer.get());
+                mapping = buffer;
+#endif
+            }
+
+            void advise(ADVICE advice) const {
+#ifdef __linux__
+                static const int flags[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED};
+                if (count > 0) {
+                    ::madvise(const_cast<T *>(items), count * sizeof(T), flags[advice]);
+                }
+#endif
+            }
+
+            static size_t page_size() {
+#ifdef __linux__
+                static const size_t size = (size_t) ::sysconf(_SC_PAGESIZE);
+                return size;
+#else
+                return 4096;
+#endif
+            }
+
+            const T *begin() const {
+                return items;
+            }
+
+            const T *end() const {
+                return items + count;
+            }
+
+            const T *data() const {
+                return items;
+            }
+
+            size_t size() const {
+                return count;
+            }
+
+            bool empty() const {
+                return count == 0;
+            }
+
+            const T &operator[](size_t idx) const {
+                return items[idx];
+            }
+
+        private:
+            std::shared_ptr<const void> mapping;
+            const T *items;
+            size_t count;
+        };
+    }
+
+    using memory::mapped_array;
+
+    template<typename T>
+    struct _result_container<mapped_array<T>> {
+        using type = std::vector<T>;
+    };
+
+    //  type of function(item) for the items of Container.
+    template<typename Container, typename Function>
+    struct _result_of {
+        using type = typename std::decay<decltype(std::declval<Function &>()(
+                std::declval<const typename Container::value_type &>()))>::type;
+    };
+
+    //  reduces the items of every group without collecting them: keeps one
+    //  accumulator per key, starting from init.
+    template<typename GroupKey, template<typename...> class Map = std::map,
+            typename Container, typename KeyFunction, typename Function, typename ResultType>
+    Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                          Function function, ResultType init) {
+        Map<GroupKey, ResultType> result;
+        for (const auto &item : container) {
+            GroupKey key = keyFunction(item);
+            auto found = result.find(key);
+            if (found == result.end()) {
+                found = result.insert(std::make_pair(key, init)).first;
+            }
+            found->second = function(found->second, item);
+        }
+        return result;
+    };
+
+    template<typename GroupKey, template<typename...> class Map = std::map,
+            typename Container, typename KeyFunction, typename Function, typename ResultType, typename Combiner>
+    Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                          Function function, ResultType init, Combiner combiner) {
+        return groupReduce<GroupKey, Map>(container, keyFunction, function, init);
+    };
+
+    template<typename GroupKey, template<typename...> class Map = std::map,
+            typename Container, typename KeyFunction>
+    Map<GroupKey, size_t> countBy(const Container &container, KeyFunction keyFunction) {
+        return groupReduce<GroupKey, Map>(container, keyFunction,
+                                          [](size_t memo, const typename Container::value_type &item) -> size_t {
+                                              return memo + 1;
+                                          }, (size_t) 0);
+    };
+
+    template<typename GroupKey, template<typename...> class Map = std::map,
+            typename Container, typename KeyFunction, typename ValueFunction>
+    Map<GroupKey, typename _result_of<Container, ValueFunction>::type>
+    sumBy(const Container &container, KeyFunction keyFunction, ValueFunction valueFunction) {
+        using result_type = typename _result_of<Container, ValueFunction>::type;
+        return groupReduce<GroupKey, Map>(container, keyFunction,
+                                          [&valueFunction](const result_type &memo,
+                                                           const typename Container::value_type &item) -> result_type {
+                                              return memo + valueFunction(item);
+                                          }, result_type());
+    };
+
+    template<typename ResultType, typename Container, typename Function>
+    ResultType reduce(const Container &container, Function function, ResultType init) {
+        ResultType result = init;
+        each(container, [&result, &function](const typename Container::value_type &item) {
+            result = function(result, item);
+        });
+        return result;
+    };
+
+    //  map over a vector of numbers with an _::ops function runs the simd
+    //  kernel for it.
+    template<typename ResultContainer, typename T, typename Kind>
+    typename std::enable_if<std::is_same<ResultContainer, std::vector<T>>::value && std::is_arithmetic<T>::value,
+            ResultContainer>::type
+    map(const std::vector<T> &container, ops::elementwise<Kind, T> function) {
+        ResultContainer result(container.size());
+        simd::apply(function, container.data(), result.data(), container.size());
+        return result;
+    };
+
+    template<typename ResultContainer, typename T, typename Kind>
+    typename std::enable_if<std::is_same<ResultContainer, std::vector<T>>::value && std::is_arithmetic<T>::value,
+            ResultContainer>::type
+    map(std::vector<T> &&container, ops::elementwise<Kind, T> function) {
+        simd::apply(function, container.data(), container.data(), container.size());
+        return std::move(container);
+    };
+
+    //  reduce of a vector of numbers with std::plus runs the sum kernel,
+    //  which adds in lanes: float and double results may differ in the
+    //  last bits from a left-to-right fold.
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value, T>::type
+    reduce(const std::vector<T> &container, std::plus<T> function, T init) {
+        return (T) (init + simd::sum(container.data(), container.size()));
+    };
+
+    template<typename Container>
+    typename simd::sum_type<typename Container::value_type>::type sum(const Container &container) {
+        typename simd::sum_type<typename Container::value_type>::type result = 0;
+        for (const auto &item : container) {
+            result += item;
+        }
+        return result;
+    };
+
+    template<typename T>
+    typename simd::sum_type<T>::type sum(const std::vector<T> &container) {
+        return simd::sum(container.data(), container.size());
+    };
+
+    template<typename T>
+    typename simd::sum_type<T>::type sum(const mapped_array<T> &container) {
+        return simd::sum(container.data(), container.size());
+    };
+
+    //  the smallest item, or the largest value of the type if empty.
+    template<typename Container>
+    typename Container::value_type min(const Container &container) {
+        auto result = std::numeric_limits<typename Container::value_type>::max();
+        for (const auto &item : container) {
+            result = item < result ? item : result;
+        }
+        return result;
+    };
+
+    template<typename T>
+    T min(const std::vector<T> &container) {
+        return simd::min(container.data(), container.size());
+    };
+
+    template<typename T>
+    T min(const mapped_array<T> &container) {
+        return simd::min(container.data(), container.size());
+    };
+
+    //  the largest item, or the lowest value of the type if empty.
+    template<typename Container>
+    typename Container::value_type max(const Container &container) {
+        auto result = std::numeric_limits<typename Container::value_type>::lowest();
+        for (const auto &item : container) {
+            result = item > result ? item : result;
+        }
+        return result;
+    };
+
+    template<typename T>
+    T max(const std::vector<T> &container) {
+        return simd::max(container.data(), container.size());
+    };
+
+    template<typename T>
+    T max(const mapped_array<T> &container) {
+        return simd::max(container.data(), container.size());
+    };
+
+    //  sum of the products of items at the same position, over the
+    //  shorter of the two.
+    template<typename T>
+    typename simd::sum_type<T>::type dot(const std::vector<T> &left, const std::vector<T> &right) {
+        return simd::dot(left.data(), right.data(), std::min(left.size(), right.size()));
+    };
+
+    template<typename ContainerOfContainer>
+    typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
+        typename ContainerOfContainer::value_type result;
+        for (const auto &container : containerOfContainer) {
+            for (const auto &item : container) {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+
+    //  the _into variants write to out instead of a new container, e.g. a
+    //  reused buffer or a raw pointer, and return the end of what they wrote.
+    template<typename Container, typename OutputIterator, typename Function>
+    OutputIterator map_into(const Container &container, OutputIterator out, Function function) {
+        for (const auto &item : container) {
+            *out = function(item);
+            ++out;
+        }
+        return out;
+    };
+
+    template<typename Container, typename OutputIterator, typename Function>
+    OutputIterator filter_into(const Container &container, OutputIterator out, Function function) {
+        for (const auto &item : container) {
+            if (function(item)) {
+                *out = item;
+                ++out;
+            }
+        }
+        return out;
+    };
+
+    template<typename ContainerOfContainer, typename OutputIterator>
+    OutputIterator flatten_into(const ContainerOfContainer &containerOfContainer, OutputIterator out) {
+        for (const auto &container : containerOfContainer) {
+            out = std::copy(container.begin(), container.end(), out);
+        }
+        return out;
+    }
+
+    //  the items to sort: a copy, or the vector itself when moved in.
+    template<typename Container>
+    std::vector<typename Container::value_type> _to_vector(const Container &container) {
+        return std::vector<typename Container::value_type>(container.begin(), container.end());
+    }
+
+    template<typename T>
+    std::vector<T> _to_vector(std::vector<T> &&container) {
+        return std::move(container);
+    }
+
+    template<typename Container>
+    using _value_of = typename std::decay<Container>::type::value_type;
+
+    //  orders by keyFunction(item) < keyFunction(other).
+    template<typename Item, typename KeyFunction>
+    struct _key_less {
+        KeyFunction keyFunction;
+
+        bool operator()(const Item &left, const Item &right) const {
+            return keyFunction(left) < keyFunction(right);
+        }
+    };
+
+    //  the sort functions return a vector, sorted by compare.
+    template<typename Container, typename Compare = std::less<_value_of<Container>>>
+    std::vector<_value_of<Container>> sort(Container &&container, Compare compare = Compare()) {
+        auto result = _to_vector(std::forward<Container>(container));
+        std::sort(result.begin(), result.end(), compare);
+        return result;
+    };
+
+    //  equal items keep their order.
+    template<typename Container, typename Compare = std::less<_value_of<Container>>>
+    std::vector<_value_of<Container>> stableSort(Container &&container, Compare compare = Compare()) {
+        auto result = _to_vector(std::forward<Container>(container));
+        std::stable_sort(result.begin(), result.end(), compare);
+        return result;
+    };
+
+    //  stable, by keyFunction(item).
+    template<typename Container, typename KeyFunction>
+    std::vector<_value_of<Container>> sortBy(Container &&container, KeyFunction keyFunction) {
+        return stableSort(std::forward<Container>(container),
+                          _key_less<_value_of<Container>, KeyFunction>{keyFunction});
+    };
+
+    //  keeps the k items of [first, last) that come first under compare
+    //  in heap, a heap whose front is the last of them.
+    template<typename Iterator, typename T, typename Compare>
+    void _heap_top(Iterator first, Iterator last, size_t k, std::vector<T> &heap, Compare compare) {
+        if (k == 0) {
+            return;
+        }
+        for (auto itr = first; itr != last; ++itr) {
+            if (heap.size() < k) {
+                heap.push_back(*itr);
+                std::push_heap(heap.begin(), heap.end(), compare);
+            } else if (compare(*itr, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), compare);
+                heap.back() = *itr;
+                std::push_heap(heap.begin(), heap.end(), compare);
+            }
+        }
+    }
+
+    //  the first k items under compare, in that order; by default the k
+    //  largest, largest first.
+    template<typename Container, typename Compare = std::greater<typename Container::value_type>>
+    std::vector<typename Container::value_type> topK(const Container &container, size_t k,
+                                                     Compare compare = Compare()) {
+        std::vector<typename Container::value_type> heap;
+        heap.reserve(std::min(k, (size_t) container.size()));
+        _heap_top(container.begin(), container.end(), k, heap, compare);
+        std::sort_heap(heap.begin(), heap.end(), compare);
+        return heap;
+    };
+
+    //  what findIndex returns when nothing matches.
+    const size_t NOT_FOUND = (size_t) -1;
+
+    //  the first item function(item) holds for, or container.end().
+    template<typename Container, typename Function>
+    typename Container::const_iterator find(const Container &container, Function function) {
+        return std::find_if(container.begin(), container.end(), function);
+    };
+
+    template<typename Container, typename Function>
+    size_t findIndex(const Container &container, Function function) {
+        size_t idx = 0;
+        for (const auto &item : container) {
+            if (function(item)) {
+                return idx;
+            }
+            idx++;
+        }
+        return NOT_FOUND;
+    };
+
+    template<typename Container, typename Function>
+    bool some(const Container &container, Function function) {
+        return std::any_of(container.begin(), container.end(), function);
+    };
+
+    template<typename Container, typename Function>
+    bool every(const Container &container, Function function) {
+        return std::all_of(container.begin(), container.end(), function);
+    };
+
+    //  the running values of reduce: result[i] folds items 0 to i, starting
+    //  from init.
+    template<typename ResultType, typename Container, typename Function>
+    std::vector<ResultType> scan(const Container &container, Function function, ResultType init) {
+        std::vector<ResultType> result;
+        result.reserve(container.size());
+        for (const auto &item : container) {
+            init = function(init, item);
+            result.push_back(init);
+        }
+        return result;
+    };
+
+    //  result[i] folds items 0 to i - 1, so result[0] is init.
+    template<typename ResultType, typename Container, typename Function>
+    std::vector<ResultType> exclusiveScan(const Container &container, Function function, ResultType init) {
+        std::vector<ResultType> result;
+        result.reserve(container.size());
+        for (const auto &item : container) {
+            result.push_back(init);
+            init = function(init, item);
+        }
+        return result;
+    };
+
+    //  pairs of items from two containers.
+    template<typename Left, typename Right>
+    using _joined = std::vector<std::pair<typename Left::value_type, typename Right::value_type>>;
+
+    //  pairs the items at the same position, over the shorter of the two.
+    template<typename Left, typename Right>
+    _joined<Left, Right> zip(const Left &left, const Right &right) {
+        _joined<Left, Right> result;
+        result.reserve(std::min<size_t>(left.size(), right.size()));
+        auto ritr = right.begin();
+        for (auto litr = left.begin(); litr != left.end() && ritr != right.end(); ++litr, ++ritr) {
+            result.push_back(std::make_pair(*litr, *ritr));
+        }
+        return result;
+    };
+
+    //  pairs every item of left with every item of right whose key is
+    //  equal, in the order of left and then of right. right is put in a
+    //  hash table on its keys, which need a std::hash specialization.
+    //  unmatched items of left are kept, paired with *otherwise, unless
+    //  otherwise is null.
+    template<typename Left, typename Right, typename LeftKey, typename RightKey>
+    _joined<Left, Right> _join(const Left &left, const Right &right, LeftKey leftKey, RightKey rightKey,
+                               const typename Right::value_type *otherwise) {
+        using key_type = typename _result_of<Left, LeftKey>::type;
+        std::unordered_map<key_type, std::vector<const typename Right::value_type *>> table;
+        for (const auto &item : right) {
+            table[rightKey(item)].push_back(&item);
+        }
+        _joined<Left, Right> result;
+        for (const auto &item : left) {
+            auto found = table.find(leftKey(item));
+            if (found != table.end()) {
+                for (auto match : found->second) {
+                    result.push_back(std::make_pair(item, *match));
+                }
+            } else if (otherwise != nullptr) {
+                result.push_back(std::make_pair(item, *otherwise));
+            }
+        }
+        return result;
+    };
+
+    template<typename Left, typename Right, typename LeftKey, typename RightKey>
+    _joined<Left, Right> join(const Left &left, const Right &right, LeftKey leftKey, RightKey rightKey) {
+        return _join(left, right, leftKey, rightKey, nullptr);
+    };
+
+    //  like join, but keeps the items of left without a match, paired
+    //  with otherwise.
+    template<typename Left, typename Right, typename LeftKey, typename RightKey>
+    _joined<Left, Right> leftJoin(const Left &left, const Right &right, LeftKey leftKey, RightKey rightKey,
+                                  const typename Right::value_type &otherwise = typename Right::value_type()) {
+        return _join(left, right, leftKey, rightKey, &otherwise);
+    };
+
+    //  the first item of every key, in order. keys need a std::hash
+    //  specialization.
+    template<typename Container, typename KeyFunction>
+    _collected<Container> uniqBy(const Container &container, KeyFunction keyFunction) {
+        std::unordered_set<typename _result_of<Container, KeyFunction>::type> seen;
+        _collected<Container> result;
+        for (const auto &item : container) {
+            if (seen.insert(keyFunction(item)).second) {
+                result.push_back(item);
+            }
+        }
+        return result;
+    };
+
+    template<typename Container>
+    _collected<Container> uniq(const Container &container) {
+        using value_type = typename Container::value_type;
+        return uniqBy(container, [](const value_type &item) -> const value_type & { return item; });
+    };
+}
+
+namespace _ {
+
+    namespace parallel {
+
+        class thread_pool;
+
+        //  restricts the calling thread to the given cpus. returns false where
+        //  that is not supported.
+        inline bool set_affinity(const std::vector<int> &cpus) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+            return false;
+#endif
+        }
+
+        //  the cpus the calling thread may run on, empty where that is not
+        //  known.
+        inline std::vector<int> get_affinity() {
+            std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+                for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            return cpus;
+        }
+
+        //  parses a sysfs cpu list such as "0-3,8,10-11".
+        inline std::vector<int> _parse_cpu_list(const std::string &list) {
+            std::vector<int> cpus;
+            std::istringstream in(list);
+            std::string range;
+            while (std::getline(in, range, ',')) {
+                size_t dash = range.find('-');
+                int first = std::atoi(range.c_str());
+                int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        //  cpus of every NUMA node, one list per node. a single node holding
+        //  all cpus where the topology is unknown.
+        inline std::vector<std::vector<int>> numa_nodes() {
+            std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+            for (int node = 0;; node++) {
+                std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string list;
+                if (!in || !std::getline(in, list)) {
+                    break;
+                }
+                nodes.push_back(_parse_cpu_list(list));
+            }
+#endif
+            if (nodes.empty()) {
+                std::vector<int> cpus;
+                for (unsigned int cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++) {
+                    cpus.push_back((int) cpu);
+                }
+                nodes.push_back(cpus);
+            }
+            return nodes;
+        }
+
+        inline thread_pool *&_current_pool() {
+            static thread_local thread_pool *pool = nullptr;
+            return pool;
+        }
+
+        //  the pool the calling thread is a worker of, if any.
+        inline thread_pool *&_worker_pool() {
+            static thread_local thread_pool *pool = nullptr;
+            return pool;
+        }
+
+        //  a fixed set of worker threads shared by all parallel primitives.
+        //  the thread calling a primitive works on it too, so a pool of N
+        //  workers runs each primitive with N + 1 threads.
+        class thread_pool {
+        public:
+            //  with cpus given, worker i is pinned to cpus[i % cpus.size()].
+            explicit thread_pool(unsigned int threads, const std::vector<int> &cpus = std::vector<int>()) {
+                for (unsigned int i = 0; i < threads; i++) {
+                    int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+                    workers.emplace_back([this, cpu]() {
+                        if (cpu >= 0) {
+                            set_affinity(std::vector<int>(1, cpu));
+                        }
+                        _current_pool() = this;
+                        _worker_pool() = this;
+                        work();
+                    });
+                }
+            }
+
+            thread_pool(const thread_pool &) = delete;
+
+            thread_pool &operator=(const thread_pool &) = delete;
+
+            ~thread_pool() {
+                {
+                    std::lock_guard<std::mutex> guard(_mutex);
+                    stopping = true;
+                }
+                _cond.notify_all();
+                for (auto &worker : workers) {
+                    worker.join();
+                }
+            }
+
+            unsigned int size() const {
+                return (unsigned int) workers.size();
+            }
+
+            void submit(std::function<void()> task) {
+                {
+                    std::lock_guard<std::mutex> guard(_mutex);
+                    tasks.push_back(std::move(task));
+                }
+                _cond.notify_one();
+            }
+
+            //  queues task only if a worker is waiting that will take it right
+            //  away, returns whether it did.
+            bool try_submit(std::function<void()> task) {
+                {
+                    std::lock_guard<std::mutex> guard(_mutex);
+                    if (idle <= tasks.size()) {
+                        return false;
+                    }
+                    tasks.push_back(std::move(task));
+                }
+                _cond.notify_one();
+                return true;
+            }
+
+            //  whether the calling thread is one of the workers.
+            bool is_worker() const {
+                return _worker_pool() == this;
+            }
+
+        private:
+            void work() {
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        idle++;
+                        _cond.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                        idle--;
+                        if (tasks.empty()) {
+                            return;
+                        }
+                        task = std::move(tasks.front());
+                        tasks.pop_front();
+                    }
+                    task();
+                }
+            }
+
+            std::vector<std::thread> workers;
+            std::deque<std::function<void()>> tasks;
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            size_t idle = 0;
+            bool stopping = false;
+        };
+
+        inline thread_pool &default_pool() {
+            static thread_pool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+            return pool;
+        }
+
+        inline thread_pool &current_pool() {
+            thread_pool *pool = _current_pool();
+            return pool ? *pool : default_pool();
+        }
+
+        //  makes parallel primitives called from this thread run on the
+        //  given pool until the guard goes out of scope.
+        class scoped_pool {
+        public:
+            explicit scoped_pool(thread_pool &pool) : previous(_current_pool()) {
+                _current_pool() = &pool;
+            }
+
+            scoped_pool(const scoped_pool &) = delete;
+
+            scoped_pool &operator=(const scoped_pool &) = delete;
+
+            ~scoped_pool() {
+                _current_pool() = previous;
+            }
+
+        private:
+            thread_pool *previous;
+        };
+
+        inline unsigned int get_concurrency() {
+            return current_pool().size() + 1;
+        }
+
+        //  chunks of one parallel call. participants (pool workers and the
+        //  calling thread) claim chunks until none are left, each under its
+        //  own tid in [0, get_concurrency()).
+        class _parallel_job {
+        public:
+            _parallel_job(size_t chunks, std::function<void(size_t tid, size_t chunk)> body)
+                    : chunks(chunks), body(std::move(body)) {}
+
+            void run() {
+                size_t tid = 0;
+                bool joined = false;
+                while (true) {
+                    size_t chunk = next.fetch_add(1);
+                    if (chunk >= chunks) {
+                        break;
+                    }
+                    if (!joined) {
+                        tid = tids.fetch_add(1);
+                        joined = true;
+                    }
+                    try {
+                        body(tid, chunk);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> guard(_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                    if (done.fetch_add(1) + 1 == chunks) {
+                        std::lock_guard<std::mutex> guard(_mutex);
+                        _cond.notify_all();
+                    }
+                }
+            }
+
+            void wait() {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [this]() { return done.load() == chunks; });
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+        private:
+            const size_t chunks;
+            std::function<void(size_t tid, size_t chunk)> body;
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            std::atomic<size_t> tids{0};
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            std::exception_ptr error;
+        };
+
+        inline void _parallel_run(size_t chunks, std::function<void(size_t tid, size_t chunk)> body) {
+            if (chunks == 0) {
+                return;
+            }
+            if (chunks == 1) {
+                body(0, 0);
+                return;
+            }
+            thread_pool &pool = current_pool();
+            arena *scope = _current_arena();
+            if (scope != nullptr) {
+                //  allocations of the chunks come from the caller's arena
+                body = [scope, body](size_t tid, size_t chunk) {
+                    scoped_arena scoped(scope);
+                    body(tid, chunk);
+                };
+            }
+            auto job = std::make_shared<_parallel_job>(chunks, std::move(body));
+            size_t helpers = std::min<size_t>(pool.size(), chunks - 1);
+            for (size_t i = 0; i < helpers; i++) {
+                pool.submit([job]() { job->run(); });
+            }
+            job->run();
+            job->wait();
+        }
+
+        //  a range of elements handed to one thread. idx is the position of
+        //  first in the container.
+        template<typename Iterator>
+        struct _chunk {
+            Iterator first;
+            Iterator last;
+            size_t idx;
+        };
+
+        //  chunks handed out per thread by AUTO, so a thread that got slow
+        //  elements does not hold up the others.
+        const size_t CHUNKS_PER_THREAD = 4;
+
+        //  chunks handed out per thread by DYNAMIC when no grain is given.
+        const size_t DYNAMIC_CHUNKS_PER_THREAD = 16;
+
+        //  how parallel primitives split their input into chunks.
+        //  STATIC: one chunk per thread.
+        //  DYNAMIC: chunks of grain elements, claimed by threads as they go.
+        //  without a grain, DYNAMIC_CHUNKS_PER_THREAD chunks per thread.
+        //  AUTO: CHUNKS_PER_THREAD chunks per thread of at least grain
+        //  elements. without a grain, inputs smaller than cutoff run on the
+        //  calling thread alone; pass a small grain for functions that are
+        //  expensive enough to run a few elements per task.
+        struct partitioner {
+            enum KIND {
+                STATIC,
+                DYNAMIC,
+                AUTO
+            };
+
+            KIND kind;
+            //  elements worth one chunk, 0 to derive it from the input size
+            size_t grain;
+            size_t cutoff;
+
+            partitioner(KIND kind = AUTO, size_t grain = 0, size_t cutoff = 4096)
+                    : kind(kind), grain(grain), cutoff(cutoff) {}
+
+            size_t chunks(size_t size, size_t threads) const {
+                if (size == 0) {
+                    return 0;
+                }
+                if (threads <= 1) {
+                    return 1;
+                }
+                switch (kind) {
+                    case STATIC:
+                        return std::min(size, threads);
+                    case DYNAMIC: {
+                        size_t each = grain > 0 ? grain
+                                                : std::max<size_t>(size / (threads * DYNAMIC_CHUNKS_PER_THREAD), 1);
+                        return (size + each - 1) / each;
+                    }
+                    default:
+                        if (grain == 0 && size < cutoff) {
+                            return 1;
+                        }
+                        return std::max<size_t>(std::min(size / std::max<size_t>(grain, 1),
+                                                         threads * CHUNKS_PER_THREAD), 1);
+                }
+            }
+        };
+
+        inline partitioner &_current_partitioner() {
+            static thread_local partitioner current;
+            return current;
+        }
+
+        inline const partitioner &current_partitioner() {
+            return _current_partitioner();
+        }
+
+        //  makes parallel primitives called from this thread split their
+        //  input with the given partitioner until the guard goes out of scope.
+        class scoped_partitioner {
+        public:
+            explicit scoped_partitioner(const partitioner &current) : previous(_current_partitioner()) {
+                _current_partitioner() = current;
+            }
+
+            scoped_partitioner(const scoped_partitioner &) = delete;
+
+            scoped_partitioner &operator=(const scoped_partitioner &) = delete;
+
+            ~scoped_partitioner() {
+                _current_partitioner() = previous;
+            }
+
+        private:
+            partitioner previous;
+        };
+
+        //  where and how parallel primitives run: a pool of threads - 1
+        //  workers (the calling thread is the last one), optionally pinned
+        //  to cpus, and the partitioner used to split inputs. pass it to a
+        //  primitive, to chain() or lazy(), or install it with
+        //  scoped_context, which also pins the calling thread to cpus while
+        //  it works on ctx. on multi-socket hosts, numa_contexts() makes one
+        //  per node, so all threads of a call stay next to their memory.
+        class context {
+        public:
+            explicit context(unsigned int threads = std::thread::hardware_concurrency(),
+                             const std::vector<int> &cpus = std::vector<int>(),
+                             const partitioner &partition = partitioner())
+                    : _pool(new thread_pool(std::max(threads, 1u) - 1, cpus)), _cpus(cpus), _partitioner(partition) {}
+
+            thread_pool &pool() const {
+                return *_pool;
+            }
+
+            const std::vector<int> &cpus() const {
+                return _cpus;
+            }
+
+            const partitioner &partition() const {
+                return _partitioner;
+            }
+
+            unsigned int concurrency() const {
+                return _pool->size() + 1;
+            }
+
+        private:
+            std::unique_ptr<thread_pool> _pool;
+            std::vector<int> _cpus;
+            partitioner _partitioner;
+        };
+
+        //  one context per entry of numa_nodes(), with one thread per cpu of
+        //  the node, all pinned to it. pages of results sized with
+        //  default_init_allocator are first touched by those threads, which
+        //  places them on the node under the default allocation policy.
+        inline std::vector<context> numa_contexts(const partitioner &partition = partitioner()) {
+            std::vector<context> result;
+            for (const auto &cpus : numa_nodes()) {
+                result.emplace_back((unsigned int) cpus.size(), cpus, partition);
+            }
+            return result;
+        }
+
+        //  runs parallel primitives called from this thread on ctx until the
+        //  guard goes out of scope, with this thread pinned to the cpus of
+        //  ctx if it has any. does nothing for a null ctx.
+        class scoped_context {
+        public:
+            explicit scoped_context(const context *ctx)
+                    : active(ctx != nullptr), pinned(false), previous_pool(_current_pool()),
+                      previous_partitioner(_current_partitioner()) {
+                if (active) {
+                    _current_pool() = &ctx->pool();
+                    _current_partitioner() = ctx->partition();
+                    if (!ctx->cpus().empty()) {
+                        previous_cpus = get_affinity();
+                        pinned = !previous_cpus.empty() && set_affinity(ctx->cpus());
+                    }
+                }
+            }
+
+            explicit scoped_context(const context &ctx) : scoped_context(&ctx) {}
+
+            scoped_context(const scoped_context &) = delete;
+
+            scoped_context &operator=(const scoped_context &) = delete;
+
+            ~scoped_context() {
+                if (active) {
+                    _current_pool() = previous_pool;
+                    _current_partitioner() = previous_partitioner;
+                    if (pinned) {
+                        set_affinity(previous_cpus);
+                    }
+                }
+            }
+
+        private:
+            bool active;
+            bool pinned;
+            thread_pool *previous_pool;
+            partitioner previous_partitioner;
+            std::vector<int> previous_cpus;
+        };
+
+        //  split [first, first + size) into ranges once, up front, so
+        //  threads never share an iterator. random access iterators
+        //  advance in constant time, others walk the range once.
+        template<typename Iterator>
+        std::vector<_chunk<Iterator>> _split_range(Iterator first, size_t size, size_t chunks) {
+            std::vector<_chunk<Iterator>> result;
+            result.reserve(chunks);
+            auto itr = first;
+            for (size_t i = 0; i < chunks; i++) {
+                size_t start = i * size / chunks;
+                size_t end = (i + 1) * size / chunks;
+                auto begin = itr;
+                std::advance(itr, end - start);
+                result.push_back(_chunk<Iterator>{begin, itr, start});
+            }
+            return result;
+        }
+
+        //  Container may be const, the chunks then hold const iterators.
+        template<typename Container>
+        struct _peach_selector {
+
+            using iterator_type = decltype(std::declval<Container &>().begin());
+
+            static std::vector<_chunk<iterator_type>> split(Container &container, size_t chunks) {
+                return _split_range(container.begin(), container.size(), chunks);
+            }
+        };
+
+        //  mapped files are split at page boundaries, so threads read
+        //  disjoint pages; a record that straddles one goes to the chunk
+        //  it starts in.
+        template<typename T>
+        struct _page_selector {
+
+            using iterator_type = const T *;
+
+            static std::vector<_chunk<iterator_type>> split(const mapped_array<T> &container, size_t chunks) {
+                const size_t size = container.size();
+                const size_t page = mapped_array<T>::page_size();
+                std::vector<_chunk<iterator_type>> result;
+                result.reserve(chunks);
+                size_t start = 0;
+                for (size_t i = 0; i < chunks; i++) {
+                    size_t end = size;
+                    if (i + 1 < chunks) {
+                        size_t bytes = (i + 1) * size / chunks * sizeof(T) / page * page;
+                        end = std::min(size, std::max(start, (bytes + sizeof(T) - 1) / sizeof(T)));
+                    }
+                    result.push_back(_chunk<iterator_type>{container.begin() + start, container.begin() + end, start});
+                    start = end;
+                }
+                return result;
+            }
+        };
+
+        template<typename T>
+        struct _peach_selector<mapped_array<T>> : _page_selector<T> {
+        };
+
+        template<typename T>
+        struct _peach_selector<const mapped_array<T>> : _page_selector<T> {
+        };
+
+        template<typename Container>
+        std::vector<_chunk<typename _peach_selector<Container>::iterator_type>> _split(Container &container) {
+            const size_t THREADS = get_concurrency();
+            const size_t chunks = current_partitioner().chunks(container.size(), THREADS);
+#ifdef _DEBUG
+            std::cout << "underscore: parallel with " << THREADS << " threads, "
+                      << chunks << " chunks." << std::endl;
+#endif
+            return _peach_selector<Container>::split(container, chunks);
+        };
+
+        //  function(tid, idx, elem) is called directly from the loop over a
+        //  chunk, so it can be inlined; only the per-chunk call goes through
+        //  std::function.
+        template<typename Container, typename Function>
+        void _peach(const Container &container, Function function) {
+            auto chunks = _split(container);
+            _parallel_run(chunks.size(), [&function, &chunks](size_t tid, size_t chunk) {
+                const auto last = chunks[chunk].last;
+                size_t idx = chunks[chunk].idx;
+                for (auto itr = chunks[chunk].first; itr != last; ++itr, ++idx) {
+                    function(tid, idx, *itr);
+                }
+            });
+        };
+
+        template<typename Container, typename Function>
+        void each(const Container &container, Function function) {
+            _peach<Container>(container,
+                              [&function](size_t i, size_t j, const typename Container::value_type &elem) {
+                                  function(elem);
+                              });
+        };
+
+        //  vector<bool> packs neighbours into one word, so no two threads
+        //  may write through its iterators.
+        template<typename OutputIterator>
+        struct _shared_words : std::is_same<OutputIterator, std::vector<bool>::iterator> {
+        };
+
+        template<typename ResultContainer, typename Container, typename Function>
+        ResultContainer map(const Container &container, Function function) {
+            if (_shared_words<typename ResultContainer::iterator>::value) {
+                return _::map<ResultContainer>(container, function);
+            }
+            ResultContainer result(container.size());
+            _peach(container, [&result, &function, &container](size_t tid, size_t idx,
+                                                               const typename Container::value_type &elem) {
+                result[idx] = function(elem);
+            });
+            return result;
+        };
+
+        //  joins per-chunk results in chunk order.
+        template<typename Container>
+        struct _concat_selector {
+            static Container concat(std::vector<Container> &parts) {
+                if (parts.size() == 1) {
+                    return std::move(parts[0]);
+                }
+                Container result;
+                for (auto &part : parts) {
+                    for (auto &item : part) {
+                        result.push_back(std::move(item));
+                    }
+                }
+                return result;
+            }
+        };
+
+        template<typename ValueType>
+        struct _concat_selector<std::vector<ValueType>> {
+
+            using Container = std::vector<ValueType>;
+
+            static Container concat(std::vector<Container> &parts) {
+                if (parts.size() == 1) {
+                    return std::move(parts[0]);
+                }
+                std::vector<size_t> offsets(parts.size() + 1, 0);
+                for (size_t i = 0; i < parts.size(); i++) {
+                    offsets[i + 1] = offsets[i] + parts[i].size();
+                }
+                Container result;
+                if (_shared_words<typename Container::iterator>::value) {
+                    result.reserve(offsets.back());
+                    for (auto &part : parts) {
+                        result.insert(result.end(), part.begin(), part.end());
+                    }
+                    return result;
+                }
+                result.resize(offsets.back());
+                _parallel_run(parts.size(), [&parts, &offsets, &result](size_t tid, size_t chunk) {
+                    std::move(parts[chunk].begin(), parts[chunk].end(), result.begin() + offsets[chunk]);
+                });
+                return result;
+            }
+        };
+
+        template<typename Container>
+        Container _concat(std::vector<Container> &parts) {
+            return _concat_selector<Container>::concat(parts);
+        };
+
+        //  each chunk filters into its own buffer, the buffers are then
+        //  joined in order, so the result keeps the order of the input.
+        template<typename Container, typename Function>
+        _collected<Container> filter(const Container &container, Function function) {
+            auto chunks = _split(container);
+            std::vector<_collected<Container>> parts(chunks.size());
+            _parallel_run(chunks.size(), [&chunks, &parts, &function](size_t tid, size_t chunk) {
+                auto &part = parts[chunk];
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr) {
+                    if (function(*itr)) {
+                        part.push_back(*itr);
+                    }
+                }
+            });
+            if (parts.empty()) {
+                return _collected<Container>();
+            }
+            return _concat(parts);
+        };
+
+        //  replaces every element with function(element), each chunk
+        //  writing through its own iterators.
+        template<typename Container, typename Function>
+        void transform_inplace(Container &container, Function function) {
+            if (_shared_words<typename Container::iterator>::value) {
+                _::transform_inplace(container, function);
+                return;
+            }
+            auto chunks = _split(container);
+            _parallel_run(chunks.size(), [&chunks, &function](size_t tid, size_t chunk) {
+                const auto last = chunks[chunk].last;
+                for (auto itr = chunks[chunk].first; itr != last; ++itr) {
+                    *itr = function(*itr);
+                }
+            });
+        };
+
+        template<typename ResultContainer, typename Container, typename Function>
+        typename std::enable_if<std::is_same<ResultContainer, Container>::value, ResultContainer>::type
+        map(Container &&container, Function function) {
+            transform_inplace(container, function);
+            return std::move(container);
+        };
+
+        //  compacts a container in place, keeping the order. the generic
+        //  version tests the elements in parallel, then moves the kept ones
+        //  to the front in one serial pass.
+        template<typename Container>
+        struct _compact_selector {
+            template<typename Function>
+            static void compact(Container &container, Function function) {
+                arena_vector<char> keep(container.size());
+                _peach(static_cast<const Container &>(container),
+                       [&keep, &function](size_t tid, size_t idx, const typename Container::value_type &elem) {
+                           keep[idx] = function(elem) ? 1 : 0;
+                       });
+                auto out = container.begin();
+                size_t idx = 0;
+                for (auto itr = container.begin(); itr != container.end(); ++itr, ++idx) {
+                    if (keep[idx]) {
+                        if (out != itr) {
+                            *out = std::move(*itr);
+                        }
+                        ++out;
+                    }
+                }
+                container.erase(out, container.end());
+            }
+        };
+
+        //  every chunk first compacts its kept elements to its own front in
+        //  parallel. the runs that are not yet at their final offset are then
+        //  moved out to scratch storage and back next to each other, both in
+        //  parallel, since a run may land on the one before it.
+        template<typename ValueType>
+        struct _compact_selector<std::vector<ValueType>> {
+            template<typename Function>
+            static void compact(std::vector<ValueType> &container, Function function) {
+                auto keep_not = [&function](const ValueType &item) -> bool { return !function(item); };
+                if (_shared_words<typename std::vector<ValueType>::iterator>::value) {
+                    container.erase(std::remove_if(container.begin(), container.end(), keep_not), container.end());
+                    return;
+                }
+                auto chunks = _split(container);
+                std::vector<size_t> kept(chunks.size(), 0);
+                _parallel_run(chunks.size(), [&container, &chunks, &kept, &keep_not](size_t tid, size_t chunk) {
+                    auto first = container.begin() + chunks[chunk].idx;
+                    auto last = first + (chunks[chunk].last - chunks[chunk].first);
+                    kept[chunk] = (size_t) (std::remove_if(first, last, keep_not) - first);
+                });
+                std::vector<size_t> offsets(chunks.size(), 0);
+                size_t size = 0, moved = 0;
+                for (size_t chunk = 0; chunk < chunks.size(); chunk++) {
+                    offsets[chunk] = size;
+                    if (size != chunks[chunk].idx) {
+                        moved += kept[chunk];
+                    }
+                    size += kept[chunk];
+                }
+                if (moved > 0) {
+                    std::allocator<ValueType> allocator;
+                    ValueType *scratch = allocator.allocate(size);
+                    _parallel_run(chunks.size(), [&container, &chunks, &kept, &offsets, scratch](size_t tid, size_t chunk) {
+                        if (offsets[chunk] != chunks[chunk].idx) {
+                            auto first = std::make_move_iterator(container.begin() + chunks[chunk].idx);
+                            std::uninitialized_copy(first, first + kept[chunk], scratch + offsets[chunk]);
+                        }
+                    });
+                    _parallel_run(chunks.size(), [&container, &chunks, &kept, &offsets, scratch](size_t tid, size_t chunk) {
+                        if (offsets[chunk] != chunks[chunk].idx) {
+                            auto first = scratch + offsets[chunk], last = first + kept[chunk];
+                            std::move(first, last, container.begin() + offsets[chunk]);
+                            for (auto itr = first; itr != last; ++itr) {
+                                itr->~ValueType();
+                            }
+                        }
+                    });
+                    allocator.deallocate(scratch, size);
+                }
+                container.erase(container.begin() + size, container.end());
+            }
+        };
+
+        //  kept items are moved to the front, in order, and the rest is erased.
+        template<typename Container, typename Function>
+        void filter_inplace(Container &container, Function function) {
+            _compact_selector<Container>::compact(container, function);
+        };
+
+        template<typename Container, typename Function>
+        typename std::enable_if<!std::is_reference<Container>::value &&
+                                std::is_same<_collected<Container>, Container>::value, Container>::type
+        filter(Container &&container, Function function) {
+            filter_inplace(container, function);
+            return std::move(container);
+        };
+
+        //  spreads hash values over partitions, so keys that only differ in
+        //  their low bits do not all end up in one partition.
+        inline size_t _partition_of(size_t hash, size_t partitions) {
+            return (size_t) (((unsigned long long) hash * 0x9E3779B97F4A7C15ULL) >> 32) % partitions;
+        }
+
+        //  maps with a key_compare keep their keys in order.
+        template<typename Map, typename = void>
+        struct _ordered : std::false_type {
+        };
+
+        template<typename Map>
+        struct _ordered<Map, decltype((void) std::declval<typename Map::key_compare>())> : std::true_type {
+        };
+
+        //  sends keys to partitions by their hash.
+        template<typename Map>
+        struct _hash_partitions {
+            typename Map::hasher hash;
+            size_t partitions;
+
+            size_t operator()(const typename Map::key_type &key) const {
+                return _partition_of(hash(key), partitions);
+            }
+        };
+
+        //  sends keys to partitions by range, so partition i only holds keys
+        //  below those of partition i + 1.
+        template<typename Map>
+        struct _range_partitions {
+            std::vector<typename Map::key_type> splitters;
+            typename Map::key_compare less;
+
+            size_t operator()(const typename Map::key_type &key) const {
+                return (size_t) (std::upper_bound(splitters.begin(), splitters.end(), key, less) - splitters.begin());
+            }
+        };
+
+        //  unordered maps are partitioned by hash.
+        template<typename Map, typename Chunks, typename Function>
+        _hash_partitions<Map> _key_partitions(const Chunks &chunks, size_t size, Function &function,
+                                              size_t partitions, std::false_type) {
+            return _hash_partitions<Map>{typename Map::hasher(), partitions};
+        }
+
+        //  ordered maps are partitioned by range, with splitters taken from
+        //  a sorted sample of about 32 keys per chunk. keys then need only
+        //  the map's key_compare, no std::hash.
+        template<typename Map, typename Chunks, typename Function>
+        _range_partitions<Map> _key_partitions(const Chunks &chunks, size_t size, Function &function,
+                                               size_t partitions, std::true_type) {
+            using key_type = typename Map::key_type;
+            const size_t SAMPLES = 32;
+            std::vector<std::vector<key_type>> samples(chunks.size());
+            _parallel_run(chunks.size(), [&chunks, &samples, &function, size, SAMPLES](size_t tid, size_t chunk) {
+                size_t last = chunk + 1 < chunks.size() ? chunks[chunk + 1].idx : size;
+                size_t stride = std::max<size_t>((last - chunks[chunk].idx) / SAMPLES, 1);
+                size_t step = 0;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++step) {
+                    if (step % stride == 0) {
+                        samples[chunk].push_back(function(*itr));
+                    }
+                }
+            });
+            _range_partitions<Map> result{std::vector<key_type>(), typename Map::key_compare()};
+            std::vector<key_type> sample;
+            for (auto &tsamples : samples) {
+                std::move(tsamples.begin(), tsamples.end(), std::back_inserter(sample));
+            }
+            if (sample.empty()) {
+                return result;
+            }
+            std::sort(sample.begin(), sample.end(), result.less);
+            for (size_t partition = 1; partition < partitions; partition++) {
+                result.splitters.push_back(sample[partition * sample.size() / partitions]);
+            }
+            return result;
+        }
+
+        template<typename Map>
+        auto _reserve(Map &map, size_t size, int) -> decltype(map.reserve(size), void()) {
+            map.reserve(size);
+        }
+
+        template<typename Map>
+        void _reserve(Map &map, size_t size, long) {
+        }
+
+        //  moves maps of disjoint key partitions into one, in partition
+        //  order, so ordered results append every key at their end.
+        template<typename Map, typename Table>
+        Map _join_partitions(std::vector<Table> &tables) {
+            size_t keys = 0;
+            for (const auto &table : tables) {
+                keys += table.size();
+            }
+            Map result;
+            _reserve(result, keys, 0);
+            for (auto &table : tables) {
+                for (auto &pair : table) {
+                    result.insert(result.end(), std::move(pair));
+                }
+            }
+            return result;
+        }
+
+        //  groups by key partition: chunks first sort their elements into
+        //  one bucket per partition, then each partition is grouped by one
+        //  thread. partitions own disjoint keys, so their maps are moved
+        //  into the result without merging any groups. keys of ordered maps
+        //  are split by range, so the partitions are appended in order;
+        //  unordered maps split them by hash and reserve the result first.
+        template<typename GroupKey, template<typename...> class Map, typename Container, typename Function>
+        Map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+
+            using value_type = typename Container::value_type;
+            using entry_type = std::pair<GroupKey, const value_type *>;
+            using result_type = Map<GroupKey, _collected<Container>>;
+
+            auto chunks = _split(container);
+            const size_t partitions = std::max<size_t>(get_concurrency(), 1);
+            auto partition_of = _key_partitions<result_type>(chunks, container.size(), function, partitions,
+                                                             _ordered<result_type>());
+
+            //  buckets[chunk][partition] keeps the order of the input
+            std::vector<std::vector<arena_vector<entry_type>>> buckets(
+                    chunks.size(), std::vector<arena_vector<entry_type>>(partitions));
+            _parallel_run(chunks.size(), [&chunks, &buckets, &function, &partition_of](size_t tid, size_t chunk) {
+                auto &tbuckets = buckets[chunk];
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr) {
+                    GroupKey key = function(*itr);
+                    size_t partition = partition_of(key);
+                    tbuckets[partition].push_back(entry_type(std::move(key), &*itr));
+                }
+            });
+
+            std::vector<result_type> temp(partitions);
+            _parallel_run(partitions, [&buckets, &temp](size_t tid, size_t partition) {
+                auto &ttemp = temp[partition];
+                for (const auto &tbuckets : buckets) {
+                    for (const auto &entry : tbuckets[partition]) {
+                        ttemp[entry.first].push_back(*entry.second);
+                    }
+                }
+            });
+
+            if (partitions == 1) {
+                return std::move(temp[0]);
+            }
+            return _join_partitions<result_type>(temp);
+        };
+
+        template<typename GroupKey, typename Container, typename Function>
+        std::map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+            return group<GroupKey, std::map>(container, function);
+        };
+
+        //  accumulators of one thread for the keys of one partition, kept in
+        //  the arena: ordered maps use their key_compare, unordered ones
+        //  their hasher, so keys need no more than the result map does.
+        template<typename Map, bool Ordered = _ordered<Map>::value>
+        struct _partial_table {
+            using type = std::map<typename Map::key_type, typename Map::mapped_type, typename Map::key_compare,
+                    arena_allocator<std::pair<const typename Map::key_type, typename Map::mapped_type>>>;
+        };
+
+        template<typename Map>
+        struct _partial_table<Map, false> {
+            using type = std::unordered_map<typename Map::key_type, typename Map::mapped_type, typename Map::hasher,
+                    typename Map::key_equal,
+                    arena_allocator<std::pair<const typename Map::key_type, typename Map::mapped_type>>>;
+        };
+
+        //  keeps one accumulator per key in per-thread tables, one for each
+        //  key partition, split the way group splits them. each partition
+        //  is then combined by one thread. init must be an identity for
+        //  function and combiner.
+        template<typename GroupKey, template<typename...> class Map = std::map,
+                typename Container, typename KeyFunction, typename Function, typename ResultType, typename Combiner>
+        Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                              Function function, ResultType init, Combiner combiner) {
+
+            using result_type = Map<GroupKey, ResultType>;
+            using table_type = typename _partial_table<result_type>::type;
+
+            auto chunks = _split(container);
+            const size_t partitions = std::max<size_t>(get_concurrency(), 1);
+            const size_t threads = std::min<size_t>(partitions, std::max<size_t>(chunks.size(), 1));
+            auto partition_of = _key_partitions<result_type>(chunks, container.size(), keyFunction, partitions,
+                                                             _ordered<result_type>());
+
+            //  tables[tid][partition]
+            std::vector<std::vector<table_type>> tables(threads, std::vector<table_type>(partitions));
+            _parallel_run(chunks.size(), [&chunks, &tables, &keyFunction, &function, &init, &partition_of](
+                    size_t tid, size_t chunk) {
+                auto &ttables = tables[tid];
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr) {
+                    GroupKey key = keyFunction(*itr);
+                    auto &table = ttables[partition_of(key)];
+                    auto found = table.find(key);
+                    if (found == table.end()) {
+                        found = table.insert(std::make_pair(std::move(key), init)).first;
+                    }
+                    found->second = function(found->second, *itr);
+                }
+            });
+
+            std::vector<table_type> merged(partitions);
+            _parallel_run(partitions, [&tables, &merged, &combiner](size_t tid, size_t partition) {
+                auto &tmerged = merged[partition];
+                for (auto &ttables : tables) {
+                    for (auto &pair : ttables[partition]) {
+                        auto found = tmerged.find(pair.first);
+                        if (found == tmerged.end()) {
+                            tmerged.insert(std::move(pair));
+                        } else {
+                            found->second = combiner(found->second, pair.second);
+                        }
+                    }
+                }
+            });
+            return _join_partitions<result_type>(merged);
+        };
+
+        //  function alone can not join two accumulators, so without a
+        //  combiner the fold is serial.
+        template<typename GroupKey, template<typename...> class Map = std::map,
+                typename Container, typename KeyFunction, typename Function, typename ResultType>
+        Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                              Function function, ResultType init) {
+            return _::groupReduce<GroupKey, Map>(container, keyFunction, function, init);
+        };
+
+        template<typename GroupKey, template<typename...> class Map = std::map,
+                typename Container, typename KeyFunction>
+        Map<GroupKey, size_t> countBy(const Container &container, KeyFunction keyFunction) {
+            return groupReduce<GroupKey, Map>(container, keyFunction,
+                                              [](size_t memo, const typename Container::value_type &item) -> size_t {
+                                                  return memo + 1;
+                                              }, (size_t) 0,
+                                              [](size_t left, size_t right) -> size_t {
+                                                  return left + right;
+                                              });
+        };
+
+        template<typename GroupKey, template<typename...> class Map = std::map,
+                typename Container, typename KeyFunction, typename ValueFunction>
+        Map<GroupKey, typename _result_of<Container, ValueFunction>::type>
+        sumBy(const Container &container, KeyFunction keyFunction, ValueFunction valueFunction) {
+            using result_type = typename _result_of<Container, ValueFunction>::type;
+            return groupReduce<GroupKey, Map>(container, keyFunction,
+                                              [&valueFunction](const result_type &memo,
+                                                               const typename Container::value_type &item)
+                                                      -> result_type {
+                                                  return memo + valueFunction(item);
+                                              }, result_type(),
+                                              [](const result_type &left, const result_type &right) -> result_type {
+                                                  return left + right;
+                                              });
+        };
+
+        //  holds one partial result, so a vector of them never has
+        //  _shared_words, even for bool results.
+        template<typename ValueType>
+        struct _partial {
+            ValueType value;
+        };
+
+        //  folds each chunk from init with function, then folds the partial
+        //  results in order with combiner, starting from the first one.
+        //  chunks after the first also start from init, so it must be an
+        //  identity for function, e.g. 0 for a sum.
+        template<typename ResultType, typename Container, typename Function, typename Combiner>
+        ResultType reduce(const Container &container, Function function, ResultType init, Combiner combiner) {
+            auto chunks = _split(container);
+            if (chunks.empty()) {
+                return init;
+            }
+            std::vector<_partial<ResultType>> partials(chunks.size(), _partial<ResultType>{init});
+            _parallel_run(chunks.size(), [&chunks, &partials, &function, &init](size_t tid, size_t chunk) {
+                ResultType partial = init;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr) {
+                    partial = function(partial, *itr);
+                }
+                partials[chunk].value = std::move(partial);
+            });
+            ResultType result = std::move(partials[0].value);
+            for (size_t chunk = 1; chunk < partials.size(); chunk++) {
+                result = combiner(result, partials[chunk].value);
+            }
+            return result;
+        };
+
+        //  function alone can not join two partial results, e.g. a count
+        //  that adds one per item, so without a combiner the fold is serial.
+        template<typename ResultType, typename Container, typename Function>
+        ResultType reduce(const Container &container, Function function, ResultType init) {
+            return _::reduce(container, function, init);
+        };
+
+        //  runs kernel(offset, size) on the contiguous range of every chunk
+        //  and combines the results in chunk order.
+        template<typename ResultType, typename Container, typename Kernel, typename Combiner>
+        ResultType _reduce_ranges(const Container &container, Kernel kernel, ResultType init, Combiner combiner) {
+            auto chunks = _split(container);
+            std::vector<_partial<ResultType>> partials(chunks.size(), _partial<ResultType>{init});
+            _parallel_run(chunks.size(), [&chunks, &partials, &kernel](size_t tid, size_t chunk) {
+                size_t size = (size_t) (chunks[chunk].last - chunks[chunk].first);
+                if (size > 0) {
+                    partials[chunk].value = kernel(chunks[chunk].idx, size);
+                }
+            });
+            ResultType result = init;
+            for (const auto &partial : partials) {
+                result = combiner(result, partial.value);
+            }
+            return result;
+        };
+
+        template<typename ResultContainer, typename T, typename Kind>
+        typename std::enable_if<std::is_same<ResultContainer, std::vector<T>>::value && std::is_arithmetic<T>::value,
+                ResultContainer>::type
+        map(const std::vector<T> &container, ops::elementwise<Kind, T> function) {
+            ResultContainer result(container.size());
+            auto chunks = _split(container);
+            _parallel_run(chunks.size(), [&chunks, &container, &result, &function](size_t tid, size_t chunk) {
+                size_t offset = chunks[chunk].idx;
+                simd::apply(function, container.data() + offset, result.data() + offset,
+                            (size_t) (chunks[chunk].last - chunks[chunk].first));
+            });
+            return result;
+        };
+
+        template<typename ResultContainer, typename T, typename Kind>
+        typename std::enable_if<std::is_same<ResultContainer, std::vector<T>>::value && std::is_arithmetic<T>::value,
+                ResultContainer>::type
+        map(std::vector<T> &&container, ops::elementwise<Kind, T> function) {
+            auto chunks = _split(container);
+            T *data = container.data();
+            _parallel_run(chunks.size(), [&chunks, data, &function](size_t tid, size_t chunk) {
+                size_t offset = chunks[chunk].idx;
+                simd::apply(function, data + offset, data + offset, (size_t) (chunks[chunk].last - chunks[chunk].first));
+            });
+            return std::move(container);
+        };
+
+        //  containers whose items sit in one array behind data().
+        template<typename Container>
+        struct _contiguous : std::false_type {
+        };
+
+        template<typename T, typename Allocator>
+        struct _contiguous<std::vector<T, Allocator>>
+                : std::integral_constant<bool, !_shared_words<typename std::vector<T, Allocator>::iterator>::value> {
+        };
+
+        template<typename T>
+        struct _contiguous<mapped_array<T>> : std::true_type {
+        };
+
+        template<typename Container, typename T = typename Container::value_type>
+        typename std::enable_if<_contiguous<Container>::value, typename simd::sum_type<T>::type>::type
+        sum(const Container &container) {
+            using result_type = typename simd::sum_type<T>::type;
+            const T *data = container.data();
+            return _reduce_ranges(container, [data](size_t offset, size_t size) -> result_type {
+                return simd::sum(data + offset, size);
+            }, result_type(), [](result_type left, result_type right) -> result_type {
+                return left + right;
+            });
+        };
+
+        template<typename T>
+        typename std::enable_if<std::is_arithmetic<T>::value, T>::type
+        reduce(const std::vector<T> &container, std::plus<T> function, T init) {
+            return (T) (init + sum(container));
+        };
+
+        template<typename Container, typename T = typename Container::value_type>
+        typename std::enable_if<_contiguous<Container>::value, T>::type min(const Container &container) {
+            const T *data = container.data();
+            return _reduce_ranges(container, [data](size_t offset, size_t size) -> T {
+                return simd::min(data + offset, size);
+            }, std::numeric_limits<T>::max(), [](T left, T right) -> T {
+                return right < left ? right : left;
+            });
+        };
+
+        template<typename Container, typename T = typename Container::value_type>
+        typename std::enable_if<_contiguous<Container>::value, T>::type max(const Container &container) {
+            const T *data = container.data();
+            return _reduce_ranges(container, [data](size_t offset, size_t size) -> T {
+                return simd::max(data + offset, size);
+            }, std::numeric_limits<T>::lowest(), [](T left, T right) -> T {
+                return right > left ? right : left;
+            });
+        };
+
+        template<typename T>
+        typename simd::sum_type<T>::type dot(const std::vector<T> &left, const std::vector<T> &right) {
+            using result_type = typename simd::sum_type<T>::type;
+            const T *ldata = left.data();
+            const T *rdata = right.data();
+            const std::vector<T> &shorter = left.size() <= right.size() ? left : right;
+            return _reduce_ranges(shorter, [ldata, rdata](size_t offset, size_t size) -> result_type {
+                return simd::dot(ldata + offset, rdata + offset, size);
+            }, result_type(), [](result_type left, result_type right) -> result_type {
+                return left + right;
+            });
+        };
+
+        //  std::merge into uninitialized storage, moving the items.
+        template<typename T, typename Compare>
+        void _merge_construct(T *first1, T *last1, T *first2, T *last2, T *out, Compare &compare) {
+            while (first1 != last1 && first2 != last2) {
+                if (compare(*first2, *first1)) {
+                    new (out++) T(std::move(*first2++));
+                } else {
+                    new (out++) T(std::move(*first1++));
+                }
+            }
+            out = std::uninitialized_copy(std::make_move_iterator(first1), std::make_move_iterator(last1), out);
+            std::uninitialized_copy(std::make_move_iterator(first2), std::make_move_iterator(last2), out);
+        }
+
+        //  merges the sorted runs [bounds[i], bounds[i + 1]) of data
+        //  pairwise, round by round, until one is left. every merge is cut
+        //  into pieces at the lower bound of a left item in the right run,
+        //  so all threads take part when few runs are left. stable. rounds
+        //  alternate between data and raw scratch storage, which the first
+        //  round move-constructs, so T need not be default constructible.
+        template<typename T, typename Compare>
+        void _merge_runs(std::vector<T> &data, std::vector<size_t> bounds, Compare compare) {
+
+            struct piece {
+                size_t first1, last1, first2, last2, out;
+            };
+
+            if (bounds.size() <= 2) {
+                return;
+            }
+            const size_t size = data.size();
+            std::allocator<T> allocator;
+            T *scratch = allocator.allocate(size);
+            bool constructed = false, in_scratch = false;
+            const size_t slots = get_concurrency() * CHUNKS_PER_THREAD;
+            while (bounds.size() > 2) {
+                T *from = in_scratch ? scratch : data.data();
+                T *to = in_scratch ? data.data() : scratch;
+                const size_t runs = bounds.size() - 1;
+                const size_t pieces_per_merge = std::max<size_t>(1, slots / std::max<size_t>(runs / 2, 1));
+                std::vector<piece> pieces;
+                std::vector<size_t> next(1, 0);
+                for (size_t run = 0; run + 1 < runs; run += 2) {
+                    const size_t first = bounds[run], middle = bounds[run + 1], last = bounds[run + 2];
+                    size_t from1 = first, from2 = middle;
+                    for (size_t k = 1; k <= pieces_per_merge; k++) {
+                        size_t to1 = k == pieces_per_merge ? middle : first + (middle - first) * k / pieces_per_merge;
+                        size_t to2 = to1 == middle ? last : (size_t) (std::lower_bound(
+                                from + from2, from + last, from[to1], compare) - from);
+                        pieces.push_back(piece{from1, to1, from2, to2, from1 + from2 - middle});
+                        from1 = to1;
+                        from2 = to2;
+                    }
+                    next.push_back(last);
+                }
+                if (runs % 2 == 1) {
+                    pieces.push_back(piece{bounds[runs - 1], bounds[runs], bounds[runs], bounds[runs], bounds[runs - 1]});
+                    next.push_back(bounds[runs]);
+                }
+                const bool construct = !constructed;
+                _parallel_run(pieces.size(), [from, to, construct, &pieces, &compare](size_t tid, size_t idx) {
+                    const piece &p = pieces[idx];
+                    if (construct) {
+                        _merge_construct(from + p.first1, from + p.last1, from + p.first2, from + p.last2,
+                                         to + p.out, compare);
+                    } else {
+                        std::merge(std::make_move_iterator(from + p.first1), std::make_move_iterator(from + p.last1),
+                                   std::make_move_iterator(from + p.first2), std::make_move_iterator(from + p.last2),
+                                   to + p.out, compare);
+                    }
+                });
+                constructed = true;
+                in_scratch = !in_scratch;
+                bounds.swap(next);
+            }
+            auto chunks = _split(data);
+            _parallel_run(chunks.size(), [&chunks, scratch, in_scratch](size_t tid, size_t chunk) {
+                T *first = scratch + chunks[chunk].idx;
+                T *last = first + (chunks[chunk].last - chunks[chunk].first);
+                if (in_scratch) {
+                    std::move(first, last, chunks[chunk].first);
+                }
+                for (T *itr = first; itr != last; ++itr) {
+                    itr->~T();
+                }
+            });
+            allocator.deallocate(scratch, size);
+        }
+
+        //  sorts every chunk on its own thread, then merges the chunks.
+        template<typename T, typename Compare>
+        void _sort(std::vector<T> &data, Compare compare, bool stable) {
+            auto chunks = _split(data);
+            if (chunks.size() <= 1 || _shared_words<typename std::vector<T>::iterator>::value) {
+                if (stable) {
+                    std::stable_sort(data.begin(), data.end(), compare);
+                } else {
+                    std::sort(data.begin(), data.end(), compare);
+                }
+                return;
+            }
+            std::vector<size_t> bounds;
+            for (const auto &chunk : chunks) {
+                bounds.push_back(chunk.idx);
+            }
+            bounds.push_back(data.size());
+            _parallel_run(chunks.size(), [&chunks, &compare, stable](size_t tid, size_t chunk) {
+                if (stable) {
+                    std::stable_sort(chunks[chunk].first, chunks[chunk].last, compare);
+                } else {
+                    std::sort(chunks[chunk].first, chunks[chunk].last, compare);
+                }
+            });
+            _merge_runs(data, bounds, compare);
+        }
+
+        template<typename Container, typename Compare = std::less<_value_of<Container>>>
+        std::vector<_value_of<Container>> sort(Container &&container, Compare compare = Compare()) {
+            auto result = _to_vector(std::forward<Container>(container));
+            _sort(result, compare, false);
+            return result;
+        };
+
+        template<typename Container, typename Compare = std::less<_value_of<Container>>>
+        std::vector<_value_of<Container>> stableSort(Container &&container, Compare compare = Compare()) {
+            auto result = _to_vector(std::forward<Container>(container));
+            _sort(result, compare, true);
+            return result;
+        };
+
+        template<typename Container, typename KeyFunction>
+        std::vector<_value_of<Container>> sortBy(Container &&container, KeyFunction keyFunction) {
+            return parallel::stableSort(std::forward<Container>(container),
+                                        _key_less<_value_of<Container>, KeyFunction>{keyFunction});
+        };
+
+        //  every chunk keeps its own heap of k items, the heaps are then
+        //  merged on the calling thread.
+        template<typename Container, typename Compare = std::greater<typename Container::value_type>>
+        std::vector<typename Container::value_type> topK(const Container &container, size_t k,
+                                                         Compare compare = Compare()) {
+            using value_type = typename Container::value_type;
+            auto chunks = _split(container);
+            std::vector<std::vector<value_type>> heaps(chunks.size());
+            _parallel_run(chunks.size(), [&chunks, &heaps, &compare, k](size_t tid, size_t chunk) {
+                _heap_top(chunks[chunk].first, chunks[chunk].last, k, heaps[chunk], compare);
+            });
+            std::vector<value_type> result;
+            for (const auto &heap : heaps) {
+                _heap_top(heap.begin(), heap.end(), k, result, compare);
+            }
+            std::sort_heap(result.begin(), result.end(), compare);
+            return result;
+        };
+
+        //  how many items a search runs between looks at the shared result.
+        const size_t SEARCH_STRIDE = 64;
+
+        //  the lowest index function(item) holds for, and the iterator to
+        //  it. chunks leave off once a match below them is known, and
+        //  chunks past it are skipped.
+        template<typename Container, typename Function>
+        std::pair<size_t, typename Container::const_iterator> _find(const Container &container, Function function) {
+            auto chunks = _split(container);
+            std::atomic<size_t> best{NOT_FOUND};
+            std::vector<std::pair<size_t, typename Container::const_iterator>> found(
+                    chunks.size(), std::make_pair(NOT_FOUND, container.end()));
+            _parallel_run(chunks.size(), [&chunks, &function, &best, &found](size_t tid, size_t chunk) {
+                size_t idx = chunks[chunk].idx;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                    if (idx % SEARCH_STRIDE == 0 && idx > best.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+                    if (function(*itr)) {
+                        found[chunk] = std::make_pair(idx, itr);
+                        size_t current = best.load();
+                        while (idx < current && !best.compare_exchange_weak(current, idx)) {
+                        }
+                        return;
+                    }
+                }
+            });
+            //  chunks before the lowest match never leave off early
+            for (const auto &match : found) {
+                if (match.first != NOT_FOUND) {
+                    return match;
+                }
+            }
+            return std::make_pair(NOT_FOUND, container.end());
+        };
+
+        template<typename Container, typename Function>
+        typename Container::const_iterator find(const Container &container, Function function) {
+            return _find(container, function).second;
+        };
+
+        template<typename Container, typename Function>
+        size_t findIndex(const Container &container, Function function) {
+            return _find(container, function).first;
+        };
+
+        //  every chunk stops as soon as any of them finds a match.
+        template<typename Container, typename Function>
+        bool some(const Container &container, Function function) {
+            auto chunks = _split(container);
+            std::atomic<bool> found{false};
+            _parallel_run(chunks.size(), [&chunks, &function, &found](size_t tid, size_t chunk) {
+                size_t steps = 0;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++steps) {
+                    if (steps % SEARCH_STRIDE == 0 && found.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+                    if (function(*itr)) {
+                        found.store(true);
+                        return;
+                    }
+                }
+            });
+            return found.load();
+        };
+
+        template<typename Container, typename Function>
+        bool every(const Container &container, Function function) {
+            return !parallel::some(container, [&function](const typename Container::value_type &item) -> bool {
+                return !function(item);
+            });
+        };
+
+        //  two passes over the chunks: the first folds every chunk, the
+        //  running combination of those totals then seeds each chunk in the
+        //  second, which writes the running values. chunks after the first
+        //  also fold their totals from init, so it must be an identity for
+        //  function.
+        template<typename ResultType, typename Container, typename Function, typename Combiner>
+        std::vector<ResultType> _scan(const Container &container, Function function, ResultType init,
+                                      Combiner combiner, bool inclusive) {
+            auto chunks = _split(container);
+            if (chunks.size() <= 1 || _shared_words<typename std::vector<ResultType>::iterator>::value) {
+                return inclusive ? _::scan(container, function, init) : _::exclusiveScan(container, function, init);
+            }
+            std::vector<_partial<ResultType>> totals(chunks.size(), _partial<ResultType>{init});
+            _parallel_run(chunks.size(), [&chunks, &totals, &function](size_t tid, size_t chunk) {
+                ResultType total = totals[chunk].value;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr) {
+                    total = function(total, *itr);
+                }
+                totals[chunk].value = total;
+            });
+            std::vector<_partial<ResultType>> starts(chunks.size(), _partial<ResultType>{init});
+            starts[1].value = totals[0].value;
+            for (size_t chunk = 2; chunk < chunks.size(); chunk++) {
+                starts[chunk].value = combiner(starts[chunk - 1].value, totals[chunk - 1].value);
+            }
+            std::vector<ResultType> result(container.size());
+            _parallel_run(chunks.size(), [&chunks, &starts, &result, &function, inclusive](size_t tid, size_t chunk) {
+                ResultType running = starts[chunk].value;
+                size_t idx = chunks[chunk].idx;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                    if (inclusive) {
+                        running = function(running, *itr);
+                        result[idx] = running;
+                    } else {
+                        result[idx] = running;
+                        running = function(running, *itr);
+                    }
+                }
+            });
+            return result;
+        };
+
+        template<typename ResultType, typename Container, typename Function, typename Combiner>
+        std::vector<ResultType> scan(const Container &container, Function function, ResultType init,
+                                     Combiner combiner) {
+            return _scan(container, function, init, combiner, true);
+        };
+
+        //  function alone can not join two partial results, so without a
+        //  combiner the scan is serial.
+        template<typename ResultType, typename Container, typename Function>
+        std::vector<ResultType> scan(const Container &container, Function function, ResultType init) {
+            return _::scan(container, function, init);
+        };
+
+        template<typename ResultType, typename Container, typename Function, typename Combiner>
+        std::vector<ResultType> exclusiveScan(const Container &container, Function function, ResultType init,
+                                              Combiner combiner) {
+            return _scan(container, function, init, combiner, false);
+        };
+
+        template<typename ResultType, typename Container, typename Function>
+        std::vector<ResultType> exclusiveScan(const Container &container, Function function, ResultType init) {
+            return _::exclusiveScan(container, function, init);
+        };
+
+        //  runs every chunk through stage into its own copy of sink and
+        //  returns the sinks in chunk order.
+        template<typename Container, typename Stage, typename Sink>
+        std::vector<Sink> pipe(const Container &container, const Stage &stage, const Sink &sink) {
+            auto chunks = _split(container);
+            std::vector<Sink> sinks(chunks.size(), sink);
+            _parallel_run(chunks.size(), [&chunks, &sinks, &stage](size_t tid, size_t chunk) {
+                auto &tsink = sinks[chunk];
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr) {
+                    stage.push(*itr, tsink);
+                }
+            });
+            return sinks;
+        };
+
+        //  the _into variants need a random access out, every chunk writes
+        //  its own sub-range of it.
+        template<typename Container, typename OutputIterator, typename Function>
+        OutputIterator map_into(const Container &container, OutputIterator out, Function function) {
+            if (_shared_words<OutputIterator>::value) {
+                return _::map_into(container, out, function);
+            }
+            _peach(container, [&out, &function](size_t tid, size_t idx, const typename Container::value_type &elem) {
+                out[idx] = function(elem);
+            });
+            return out + container.size();
+        };
+
+        //  every chunk marks and counts the items it keeps, then copies them
+        //  to out at the offset of the chunk, so the order is kept and
+        //  function runs once per item.
+        template<typename Container, typename OutputIterator, typename Function>
+        OutputIterator filter_into(const Container &container, OutputIterator out, Function function) {
+            if (_shared_words<OutputIterator>::value) {
+                return _::filter_into(container, out, function);
+            }
+            auto chunks = _split(container);
+            arena_vector<char> keep(container.size());
+            std::vector<size_t> offsets(chunks.size() + 1, 0);
+            _parallel_run(chunks.size(), [&chunks, &keep, &offsets, &function](size_t tid, size_t chunk) {
+                size_t idx = chunks[chunk].idx;
+                size_t kept = 0;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                    keep[idx] = function(*itr) ? 1 : 0;
+                    kept += keep[idx];
+                }
+                offsets[chunk + 1] = kept;
+            });
+            for (size_t chunk = 0; chunk < chunks.size(); chunk++) {
+                offsets[chunk + 1] += offsets[chunk];
+            }
+            _parallel_run(chunks.size(), [&chunks, &keep, &offsets, &out](size_t tid, size_t chunk) {
+                size_t idx = chunks[chunk].idx;
+                auto dest = out + offsets[chunk];
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                    if (keep[idx]) {
+                        *dest = *itr;
+                        ++dest;
+                    }
+                }
+            });
+            return out + offsets.back();
+        };
+
+        //  where each inner container ends in the flattened output.
+        template<typename ContainerOfContainer>
+        std::vector<size_t> _flatten_ends(const ContainerOfContainer &containerOfContainer) {
+            using inner_type = typename ContainerOfContainer::value_type;
+            return parallel::scan(containerOfContainer, [](size_t memo, const inner_type &container) -> size_t {
+                return memo + container.size();
+            }, (size_t) 0, std::plus<size_t>());
+        }
+
+        //  copies count items of container, starting at position from.
+        template<typename Container, typename OutputIterator>
+        void _copy_range(const Container &container, size_t from, size_t count, OutputIterator out) {
+            auto first = container.begin();
+            std::advance(first, from);
+            std::copy_n(first, count, out);
+        }
+
+        //  arrays of trivially copyable items are copied in bulk.
+        template<typename Container, typename T>
+        typename std::enable_if<_contiguous<Container>::value && std::is_trivially_copyable<T>::value &&
+                                std::is_same<typename Container::value_type, T>::value>::type
+        _copy_range(const Container &container, size_t from, size_t count, T *out) {
+            if (count > 0) {
+                std::memcpy(out, container.data() + from, count * sizeof(T));
+            }
+        }
+
+        //  where to write a sized result: its array when it has one.
+        template<typename Container>
+        typename std::enable_if<_contiguous<Container>::value, typename Container::value_type *>::type
+        _output_of(Container &container) {
+            return container.data();
+        }
+
+        template<typename Container>
+        typename std::enable_if<!_contiguous<Container>::value, typename Container::iterator>::type
+        _output_of(Container &container) {
+            return container.begin();
+        }
+
+        //  the addresses of the items by position, for containers without
+        //  random access.
+        template<typename Container>
+        std::vector<const typename Container::value_type *> _addresses(const Container &container) {
+            using value_type = typename Container::value_type;
+            std::vector<const value_type *> result(container.size());
+            _peach(container, [&result](size_t tid, size_t idx, const value_type &item) {
+                result[idx] = &item;
+            });
+            return result;
+        }
+
+        //  out can not jump to an offset, so the items are written in order.
+        template<typename ContainerOfContainer, typename OutputIterator, typename Category>
+        OutputIterator _flatten_to(const ContainerOfContainer &containerOfContainer, const std::vector<size_t> &ends,
+                                   OutputIterator out, Category) {
+            return _::flatten_into(containerOfContainer, out);
+        }
+
+        //  the output is split into equal ranges regardless of where the
+        //  inner containers end, so a few large ones among many small ones
+        //  do not leave one thread with most of the copying. a range starts
+        //  in the inner container found by binary search on ends.
+        template<typename ContainerOfContainer, typename OutputIterator>
+        OutputIterator _flatten_to(const ContainerOfContainer &containerOfContainer, const std::vector<size_t> &ends,
+                                   OutputIterator out, std::random_access_iterator_tag) {
+            const size_t total = ends.empty() ? 0 : ends.back();
+            if (_shared_words<OutputIterator>::value || total == 0) {
+                return _::flatten_into(containerOfContainer, out);
+            }
+            //  the inner containers by position, for any outer container
+            auto inners = _addresses(containerOfContainer);
+            const size_t chunks = current_partitioner().chunks(total, get_concurrency());
+            _parallel_run(chunks, [&inners, &ends, &out, total, chunks](size_t tid, size_t chunk) {
+                size_t pos = chunk * total / chunks;
+                const size_t last = (chunk + 1) * total / chunks;
+                size_t i = std::upper_bound(ends.begin(), ends.end(), pos) - ends.begin();
+                for (; pos < last; i++) {
+                    size_t start = i == 0 ? 0 : ends[i - 1];
+                    size_t count = std::min(ends[i], last) - pos;
+                    _copy_range(*inners[i], pos - start, count, out + pos);
+                    pos += count;
+                }
+            });
+            return out + total;
+        }
+
+        template<typename ContainerOfContainer, typename OutputIterator>
+        OutputIterator flatten_into(const ContainerOfContainer &containerOfContainer, OutputIterator out) {
+            return _flatten_to(containerOfContainer, _flatten_ends(containerOfContainer), out,
+                               typename std::iterator_traits<OutputIterator>::iterator_category());
+        }
+
+        //  with _::default_init_allocator the result is not zeroed before
+        //  it is copied into.
+        template<typename ContainerOfContainer>
+        typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
+            using result_type = typename ContainerOfContainer::value_type;
+            auto ends = _flatten_ends(containerOfContainer);
+            result_type result(ends.empty() ? 0 : ends.back());
+            auto out = _output_of(result);
+            _flatten_to(containerOfContainer, ends, out,
+                        typename std::iterator_traits<decltype(out)>::iterator_category());
+            return result;
+        }
+
+        //  pairs the items at the same position, over the shorter of the
+        //  two. both are split into the same ranges.
+        template<typename Left, typename Right>
+        _joined<Left, Right> zip(const Left &left, const Right &right) {
+            const size_t size = std::min<size_t>(left.size(), right.size());
+            const size_t chunks = current_partitioner().chunks(size, get_concurrency());
+            auto lchunks = _split_range(left.begin(), size, chunks);
+            auto rchunks = _split_range(right.begin(), size, chunks);
+            _joined<Left, Right> result(size);
+            _parallel_run(chunks, [&lchunks, &rchunks, &result](size_t tid, size_t chunk) {
+                size_t idx = lchunks[chunk].idx;
+                auto ritr = rchunks[chunk].first;
+                for (auto litr = lchunks[chunk].first; litr != lchunks[chunk].last; ++litr, ++ritr, ++idx) {
+                    result[idx] = std::make_pair(*litr, *ritr);
+                }
+            });
+            return result;
+        };
+
+        //  how many items the build side of a join needs before its hash
+        //  table is built by all threads, one partition each.
+        const size_t JOIN_PARTITION_SIZE = 1 << 15;
+
+        //  a hash table from keys to the positions of the items with that
+        //  key: every entry holds the first and the last of them, next[i]
+        //  is the one after i, or NOT_FOUND.
+        template<typename Key>
+        struct _join_table {
+            std::vector<arena_unordered_map<Key, std::pair<size_t, size_t>>> partitions;
+            std::vector<size_t> next;
+        };
+
+        //  builds the table on items, addresses of the items of one side.
+        //  large sides are first sorted into one bucket of positions per
+        //  partition by every chunk, then each partition is built by one
+        //  thread, so keys are never shared between threads.
+        template<typename Key, typename Items, typename KeyFunction>
+        _join_table<Key> _join_build(const Items &items, KeyFunction keyFunction) {
+            const size_t partitions = items.size() < JOIN_PARTITION_SIZE ? 1 : std::max<size_t>(get_concurrency(), 1);
+            _join_table<Key> table;
+            table.partitions.resize(partitions);
+            table.next.assign(items.size(), NOT_FOUND);
+            std::hash<Key> hash;
+
+            //  buckets[chunk][partition] keeps the positions in order
+            std::vector<std::vector<arena_vector<size_t>>> buckets;
+            if (partitions > 1) {
+                auto chunks = _split(items);
+                buckets.assign(chunks.size(), std::vector<arena_vector<size_t>>(partitions));
+                _parallel_run(chunks.size(), [&chunks, &buckets, &keyFunction, &hash, partitions](
+                        size_t tid, size_t chunk) {
+                    auto &tbuckets = buckets[chunk];
+                    size_t idx = chunks[chunk].idx;
+                    for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                        tbuckets[_partition_of(hash(keyFunction(**itr)), partitions)].push_back(idx);
+                    }
+                });
+            }
+
+            _parallel_run(partitions, [&items, &keyFunction, &table, &buckets](size_t tid, size_t partition) {
+                auto &ttable = table.partitions[partition];
+                auto insert = [&items, &keyFunction, &table, &ttable](size_t idx) {
+                    Key key = keyFunction(*items[idx]);
+                    auto found = ttable.find(key);
+                    if (found == ttable.end()) {
+                        ttable.insert(std::make_pair(std::move(key), std::make_pair(idx, idx)));
+                    } else {
+                        table.next[found->second.second] = idx;
+                        found->second.second = idx;
+                    }
+                };
+                if (buckets.empty()) {
+                    for (size_t idx = 0; idx < items.size(); idx++) {
+                        insert(idx);
+                    }
+                }
+                for (const auto &tbuckets : buckets) {
+                    for (size_t idx : tbuckets[partition]) {
+                        insert(idx);
+                    }
+                }
+            });
+            return table;
+        }
+
+        //  looks up the key of every item in the table, in parallel, and
+        //  returns the pairs of positions (item, match) in the order of
+        //  items, or (match, item) when flip is set. unmatched items are
+        //  paired with NOT_FOUND when keepUnmatched is set.
+        template<typename Key, typename Items, typename KeyFunction>
+        std::vector<std::pair<size_t, size_t>> _join_probe(const _join_table<Key> &table, const Items &items,
+                                                           KeyFunction keyFunction, bool flip, bool keepUnmatched) {
+            using match_type = std::pair<size_t, size_t>;
+            auto chunks = _split(items);
+            std::vector<std::vector<match_type>> found(chunks.size());
+            _parallel_run(chunks.size(), [&chunks, &found, &table, &keyFunction, flip, keepUnmatched](
+                    size_t tid, size_t chunk) {
+                std::hash<Key> hash;
+                auto &tfound = found[chunk];
+                size_t idx = chunks[chunk].idx;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                    const Key key = keyFunction(**itr);
+                    const auto &ttable = table.partitions[_partition_of(hash(key), table.partitions.size())];
+                    auto entry = ttable.find(key);
+                    if (entry == ttable.end()) {
+                        if (keepUnmatched) {
+                            tfound.push_back(match_type(idx, NOT_FOUND));
+                        }
+                        continue;
+                    }
+                    for (size_t match = entry->second.first; match != NOT_FOUND; match = table.next[match]) {
+                        tfound.push_back(flip ? match_type(match, idx) : match_type(idx, match));
+                    }
+                }
+            });
+            return parallel::flatten(found);
+        }
+
+        //  the hash table is built on the smaller side and probed with the
+        //  other one. when that is right, the pairs come out in the order
+        //  of right and are sorted back into the order of left.
+        template<typename Left, typename Right, typename LeftKey, typename RightKey>
+        _joined<Left, Right> _join(const Left &left, const Right &right, LeftKey leftKey, RightKey rightKey,
+                                   const typename Right::value_type *otherwise) {
+            using key_type = typename _result_of<Left, LeftKey>::type;
+            using match_type = std::pair<size_t, size_t>;
+            auto lefts = _addresses(left);
+            auto rights = _addresses(right);
+
+            std::vector<match_type> matches;
+            if (right.size() <= left.size()) {
+                matches = _join_probe(_join_build<key_type>(rights, rightKey), lefts, leftKey, false,
+                                      otherwise != nullptr);
+            } else {
+                matches = parallel::sort(_join_probe(_join_build<key_type>(lefts, leftKey), rights, rightKey, true,
+                                                     false));
+                if (otherwise != nullptr) {
+                    //  left is the smaller side, so one pass over it is cheap
+                    std::vector<match_type> all;
+                    all.reserve(matches.size() + lefts.size());
+                    auto itr = matches.begin();
+                    for (size_t idx = 0; idx < lefts.size(); idx++) {
+                        if (itr == matches.end() || itr->first != idx) {
+                            all.push_back(match_type(idx, NOT_FOUND));
+                        }
+                        for (; itr != matches.end() && itr->first == idx; ++itr) {
+                            all.push_back(*itr);
+                        }
+                    }
+                    matches.swap(all);
+                }
+            }
+
+            _joined<Left, Right> result(matches.size());
+            _peach(matches, [&result, &lefts, &rights, otherwise](size_t tid, size_t idx, const match_type &match) {
+                result[idx] = std::make_pair(*lefts[match.first],
+                                             match.second == NOT_FOUND ? *otherwise : *rights[match.second]);
+            });
+            return result;
+        };
+
+        //  pairs every item of left with every item of right whose key is
+        //  equal, in the order of left and then of right.
+        template<typename Left, typename Right, typename LeftKey, typename RightKey>
+        _joined<Left, Right> join(const Left &left, const Right &right, LeftKey leftKey, RightKey rightKey) {
+            return _join(left, right, leftKey, rightKey, nullptr);
+        };
+
+        //  like join, but keeps the items of left without a match, paired
+        //  with otherwise.
+        template<typename Left, typename Right, typename LeftKey, typename RightKey>
+        _joined<Left, Right> leftJoin(const Left &left, const Right &right, LeftKey leftKey, RightKey rightKey,
+                                      const typename Right::value_type &otherwise = typename Right::value_type()) {
+            return _join(left, right, leftKey, rightKey, &otherwise);
+        };
+
+        //  keeps the first item of every key, in order. chunks sort the keys
+        //  of their items into one bucket per hash partition, then each
+        //  partition marks the first position of its keys with its own set,
+        //  so no set is shared between threads. the marked items are then
+        //  collected per chunk and joined in order, like filter.
+        template<typename Container, typename KeyFunction>
+        _collected<Container> uniqBy(const Container &container, KeyFunction keyFunction) {
+
+            using key_type = typename _result_of<Container, KeyFunction>::type;
+            using entry_type = std::pair<key_type, size_t>;
+
+            auto chunks = _split(container);
+            const size_t partitions = std::max<size_t>(get_concurrency(), 1);
+            std::hash<key_type> hash;
+
+            //  buckets[chunk][partition] keeps the order of the input
+            std::vector<std::vector<arena_vector<entry_type>>> buckets(
+                    chunks.size(), std::vector<arena_vector<entry_type>>(partitions));
+            _parallel_run(chunks.size(), [&chunks, &buckets, &keyFunction, &hash, partitions](
+                    size_t tid, size_t chunk) {
+                auto &tbuckets = buckets[chunk];
+                size_t idx = chunks[chunk].idx;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                    key_type key = keyFunction(*itr);
+                    size_t partition = _partition_of(hash(key), partitions);
+                    tbuckets[partition].push_back(entry_type(std::move(key), idx));
+                }
+            });
+
+            arena_vector<char> keep(container.size());
+            _parallel_run(partitions, [&buckets, &keep](size_t tid, size_t partition) {
+                arena_unordered_set<key_type> seen;
+                for (auto &tbuckets : buckets) {
+                    for (auto &entry : tbuckets[partition]) {
+                        if (seen.insert(std::move(entry.first)).second) {
+                            keep[entry.second] = 1;
+                        }
+                    }
+                }
+            });
+
+            std::vector<_collected<Container>> parts(chunks.size());
+            _parallel_run(chunks.size(), [&chunks, &parts, &keep](size_t tid, size_t chunk) {
+                auto &part = parts[chunk];
+                size_t idx = chunks[chunk].idx;
+                for (auto itr = chunks[chunk].first; itr != chunks[chunk].last; ++itr, ++idx) {
+                    if (keep[idx]) {
+                        part.push_back(*itr);
+                    }
+                }
+            });
+            if (parts.empty()) {
+                return _collected<Container>();
+            }
+            return _concat(parts);
+        };
+
+        template<typename Container>
+        _collected<Container> uniq(const Container &container) {
+            using value_type = typename Container::value_type;
+            return parallel::uniqBy(container, [](const value_type &item) -> const value_type & { return item; });
+        };
+
+        //  the primitives above, run on ctx.
+        template<typename Container, typename Function>
+        void each(const context &ctx, const Container &container, Function function) {
+            scoped_context scope(ctx);
+            each(container, function);
+        };
+
+        template<typename ResultContainer, typename Container, typename Function>
+        ResultContainer map(const context &ctx, const Container &container, Function function) {
+            scoped_context scope(ctx);
+            return map<ResultContainer>(container, function);
+        };
+
+        template<typename Container, typename Function>
+        _collected<Container> filter(const context &ctx, const Container &container, Function function) {
+            scoped_context scope(ctx);
+            return filter(container, function);
+        };
+
+        template<typename GroupKey, typename Container, typename Function>
+        std::map<GroupKey, _collected<Container>> group(const context &ctx, const Container &container,
+                                                        Function function) {
+            scoped_context scope(ctx);
+            return group<GroupKey>(container, function);
+        };
+
+        template<typename ResultType, typename Container, typename Function>
+        ResultType reduce(const context &ctx, const Container &container, Function function, ResultType init) {
+            scoped_context scope(ctx);
+            return reduce(container, function, init);
+        };
+
+        template<typename ResultType, typename Container, typename Function, typename Combiner>
+        ResultType reduce(const context &ctx, const Container &container, Function function, ResultType init,
+                          Combiner combiner) {
+            scoped_context scope(ctx);
+            return reduce(container, function, init, combiner);
+        };
+
+        template<typename ContainerOfContainer>
+        typename ContainerOfContainer::value_type flatten(const context &ctx,
+                                                          ContainerOfContainer &containerOfContainer) {
+            scoped_context scope(ctx);
+            return flatten(containerOfContainer);
+        }
+    }
+}
+
+namespace _ {
+
+    namespace strategy {
+
+        struct Serial {
+
+            template<typename Container, typename Function>
+            static void each(const Container &container, Function function) {
+                _::each(container, function);
+            };
+
+            template<typename ResultContainer, typename Container, typename Function>
+            static ResultContainer map(Container &&container, Function function) {
+                return _::map<ResultContainer>(std::forward<Container>(container), function);
+            };
+
+            template<typename Container, typename Function>
+            static _collected<typename std::decay<Container>::type> filter(Container &&container, Function function) {
+                return _::filter(std::forward<Container>(container), function);
+            };
+
+            template<typename Container, typename Function>
+            static void transform_inplace(Container &container, Function function) {
+                _::transform_inplace(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static void filter_inplace(Container &container, Function function) {
+                _::filter_inplace(container, function);
+            };
+
+            template<typename Container, typename OutputIterator, typename Function>
+            static OutputIterator map_into(const Container &container, OutputIterator out, Function function) {
+                return _::map_into(container, out, function);
+            };
+
+            template<typename Container, typename OutputIterator, typename Function>
+            static OutputIterator filter_into(const Container &container, OutputIterator out, Function function) {
+                return _::filter_into(container, out, function);
+            };
+
+            template<typename GroupKey, typename Container, typename Function>
+            static std::map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+
+                return _::group<GroupKey>(container, function);
+            };
+
+            template<typename GroupKey, template<typename...> class Map, typename Container, typename Function>
+            static Map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+
+                return _::group<GroupKey, Map>(container, function);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction, typename Function, typename ResultType>
+            static Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                                         Function function, ResultType init) {
+                return _::groupReduce<GroupKey, Map>(container, keyFunction, function, init);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction, typename Function, typename ResultType, typename Combiner>
+            static Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                                         Function function, ResultType init, Combiner combiner) {
+                return _::groupReduce<GroupKey, Map>(container, keyFunction, function, init, combiner);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction>
+            static Map<GroupKey, size_t> countBy(const Container &container, KeyFunction keyFunction) {
+                return _::countBy<GroupKey, Map>(container, keyFunction);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction, typename ValueFunction>
+            static Map<GroupKey, typename _result_of<Container, ValueFunction>::type>
+            sumBy(const Container &container, KeyFunction keyFunction, ValueFunction valueFunction) {
+                return _::sumBy<GroupKey, Map>(container, keyFunction, valueFunction);
+            };
+
+            template<typename ResultType, typename Container, typename Function>
+            static ResultType reduce(const Container &container, Function function, ResultType init) {
+                return _::reduce(container, function, init);
+            };
+
+            template<typename ResultType, typename Container, typename Function, typename Combiner>
+            static ResultType reduce(const Container &container, Function function, ResultType init,
+                                     Combiner combiner) {
+                return _::reduce(container, function, init);
+            };
+
+            template<typename ContainerOfContainer>
+            static typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
+
+                return _::flatten(containerOfContainer);
+            }
+
+            template<typename ContainerOfContainer, typename OutputIterator>
+            static OutputIterator flatten_into(const ContainerOfContainer &containerOfContainer, OutputIterator out) {
+                return _::flatten_into(containerOfContainer, out);
+            }
+
+            template<typename Container, typename Compare = std::less<_value_of<Container>>>
+            static std::vector<_value_of<Container>> sort(Container &&container, Compare compare = Compare()) {
+                return _::sort(std::forward<Container>(container), compare);
+            };
+
+            template<typename Container, typename Compare = std::less<_value_of<Container>>>
+            static std::vector<_value_of<Container>> stableSort(Container &&container, Compare compare = Compare()) {
+                return _::stableSort(std::forward<Container>(container), compare);
+            };
+
+            template<typename Container, typename KeyFunction>
+            static std::vector<_value_of<Container>> sortBy(Container &&container, KeyFunction keyFunction) {
+                return _::sortBy(std::forward<Container>(container), keyFunction);
+            };
+
+            template<typename Container, typename Compare = std::greater<typename Container::value_type>>
+            static std::vector<typename Container::value_type> topK(const Container &container, size_t k,
+                                                                    Compare compare = Compare()) {
+                return _::topK(container, k, compare);
+            };
+
+            template<typename Container, typename Function>
+            static typename Container::const_iterator find(const Container &container, Function function) {
+                return _::find(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static size_t findIndex(const Container &container, Function function) {
+                return _::findIndex(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static bool some(const Container &container, Function function) {
+                return _::some(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static bool every(const Container &container, Function function) {
+                return _::every(container, function);
+            };
+
+            template<typename ResultType, typename Container, typename Function>
+            static std::vector<ResultType> scan(const Container &container, Function function, ResultType init) {
+                return _::scan(container, function, init);
+            };
+
+            template<typename ResultType, typename Container, typename Function, typename Combiner>
+            static std::vector<ResultType> scan(const Container &container, Function function, ResultType init,
+                                                Combiner combiner) {
+                return _::scan(container, function, init);
+            };
+
+            template<typename ResultType, typename Container, typename Function>
+            static std::vector<ResultType> exclusiveScan(const Container &container, Function function,
+                                                         ResultType init) {
+                return _::exclusiveScan(container, function, init);
+            };
+
+            template<typename ResultType, typename Container, typename Function, typename Combiner>
+            static std::vector<ResultType> exclusiveScan(const Container &container, Function function,
+                                                         ResultType init, Combiner combiner) {
+                return _::exclusiveScan(container, function, init);
+            };
+
+            template<typename Left, typename Right>
+            static _joined<Left, Right> zip(const Left &left, const Right &right) {
+                return _::zip(left, right);
+            };
+
+            template<typename Left, typename Right, typename LeftKey, typename RightKey>
+            static _joined<Left, Right> join(const Left &left, const Right &right, LeftKey leftKey,
+                                             RightKey rightKey) {
+                return _::join(left, right, leftKey, rightKey);
+            };
+
+            template<typename Left, typename Right, typename LeftKey, typename RightKey>
+            static _joined<Left, Right> leftJoin(const Left &left, const Right &right, LeftKey leftKey,
+                                                 RightKey rightKey, const typename Right::value_type &otherwise) {
+                return _::leftJoin(left, right, leftKey, rightKey, otherwise);
+            };
+
+            template<typename Container, typename KeyFunction>
+            static _collected<Container> uniqBy(const Container &container, KeyFunction keyFunction) {
+                return _::uniqBy(container, keyFunction);
+            };
+
+            template<typename Container>
+            static _collected<Container> uniq(const Container &container) {
+                return _::uniq(container);
+            };
+
+            template<typename Container, typename Stage, typename Sink>
+            static std::vector<Sink> pipe(const Container &container, const Stage &stage, const Sink &sink) {
+                std::vector<Sink> sinks(1, sink);
+                for (const auto &item : container) {
+                    stage.push(item, sinks[0]);
+                }
+                return sinks;
+            }
+        };
+
+        struct Parallel {
+
+            template<typename Container, typename Function>
+            static void each(const Container &container, Function function) {
+                _::parallel::each(container, function);
+            };
+
+            template<typename ResultContainer, typename Container, typename Function>
+            static ResultContainer map(Container &&container, Function function) {
+                return _::parallel::map<ResultContainer>(std::forward<Container>(container), function);
+            };
+
+            template<typename Container, typename Function>
+            static _collected<typename std::decay<Container>::type> filter(Container &&container, Function function) {
+                return _::parallel::filter(std::forward<Container>(container), function);
+            };
+
+            template<typename Container, typename Function>
+            static void transform_inplace(Container &container, Function function) {
+                _::parallel::transform_inplace(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static void filter_inplace(Container &container, Function function) {
+                _::parallel::filter_inplace(container, function);
+            };
+
+            template<typename Container, typename OutputIterator, typename Function>
+            static OutputIterator map_into(const Container &container, OutputIterator out, Function function) {
+                return _::parallel::map_into(container, out, function);
+            };
+
+            template<typename Container, typename OutputIterator, typename Function>
+            static OutputIterator filter_into(const Container &container, OutputIterator out, Function function) {
+                return _::parallel::filter_into(container, out, function);
+            };
+
+            template<typename GroupKey, typename Container, typename Function>
+            static std::map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+
+                return _::parallel::group<GroupKey>(container, function);
+            };
+
+            template<typename GroupKey, template<typename...> class Map, typename Container, typename Function>
+            static Map<GroupKey, _collected<Container>> group(const Container &container, Function function) {
+
+                return _::parallel::group<GroupKey, Map>(container, function);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction, typename Function, typename ResultType>
+            static Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                                         Function function, ResultType init) {
+                return _::parallel::groupReduce<GroupKey, Map>(container, keyFunction, function, init);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction, typename Function, typename ResultType, typename Combiner>
+            static Map<GroupKey, ResultType> groupReduce(const Container &container, KeyFunction keyFunction,
+                                                         Function function, ResultType init, Combiner combiner) {
+                return _::parallel::groupReduce<GroupKey, Map>(container, keyFunction, function, init, combiner);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction>
+            static Map<GroupKey, size_t> countBy(const Container &container, KeyFunction keyFunction) {
+                return _::parallel::countBy<GroupKey, Map>(container, keyFunction);
+            };
+
+            template<typename GroupKey, template<typename...> class Map = std::map,
+                    typename Container, typename KeyFunction, typename ValueFunction>
+            static Map<GroupKey, typename _result_of<Container, ValueFunction>::type>
+            sumBy(const Container &container, KeyFunction keyFunction, ValueFunction valueFunction) {
+                return _::parallel::sumBy<GroupKey, Map>(container, keyFunction, valueFunction);
+            };
+
+            template<typename ResultType, typename Container, typename Function>
+            static ResultType reduce(const Container &container, Function function, ResultType init) {
+                return _::parallel::reduce(container, function, init);
+            };
+
+            template<typename ResultType, typename Container, typename Function, typename Combiner>
+            static ResultType reduce(const Container &container, Function function, ResultType init,
+                                     Combiner combiner) {
+                return _::parallel::reduce(container, function, init, combiner);
+            };
+
+            template<typename ContainerOfContainer>
+            static typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
+                return _::parallel::flatten(containerOfContainer);
+            }
+
+            template<typename ContainerOfContainer, typename OutputIterator>
+            static OutputIterator flatten_into(const ContainerOfContainer &containerOfContainer, OutputIterator out) {
+                return _::parallel::flatten_into(containerOfContainer, out);
+            }
+
+            template<typename Container, typename Compare = std::less<_value_of<Container>>>
+            static std::vector<_value_of<Container>> sort(Container &&container, Compare compare = Compare()) {
+                return _::parallel::sort(std::forward<Container>(container), compare);
+            };
+
+            template<typename Container, typename Compare = std::less<_value_of<Container>>>
+            static std::vector<_value_of<Container>> stableSort(Container &&container, Compare compare = Compare()) {
+                return _::parallel::stableSort(std::forward<Container>(container), compare);
+            };
+
+            template<typename Container, typename KeyFunction>
+            static std::vector<_value_of<Container>> sortBy(Container &&container, KeyFunction keyFunction) {
+                return _::parallel::sortBy(std::forward<Container>(container), keyFunction);
+            };
+
+            template<typename Container, typename Compare = std::greater<typename Container::value_type>>
+            static std::vector<typename Container::value_type> topK(const Container &container, size_t k,
+                                                                    Compare compare = Compare()) {
+                return _::parallel::topK(container, k, compare);
+            };
+
+            template<typename Container, typename Function>
+            static typename Container::const_iterator find(const Container &container, Function function) {
+                return _::parallel::find(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static size_t findIndex(const Container &container, Function function) {
+                return _::parallel::findIndex(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static bool some(const Container &container, Function function) {
+                return _::parallel::some(container, function);
+            };
+
+            template<typename Container, typename Function>
+            static bool every(const Container &container, Function function) {
+                return _::parallel::every(container, function);
+            };
+
+            template<typename ResultType, typename Container, typename Function>
+            static std::vector<ResultType> scan(const Container &container, Function function, ResultType init) {
+                return _::parallel::scan(container, function, init);
+            };
+
+            template<typename ResultType, typename Container, typename Function, typename Combiner>
+            static std::vector<ResultType> scan(const Container &container, Function function, ResultType init,
+                                                Combiner combiner) {
+                return _::parallel::scan(container, function, init, combiner);
+            };
+
+            template<typename ResultType, typename Container, typename Function>
+            static std::vector<ResultType> exclusiveScan(const Container &container, Function function,
+                                                         ResultType init) {
+                return _::parallel::exclusiveScan(container, function, init);
+            };
+
+            template<typename ResultType, typename Container, typename Function, typename Combiner>
+            static std::vector<ResultType> exclusiveScan(const Container &container, Function function,
+                                                         ResultType init, Combiner combiner) {
+                return _::parallel::exclusiveScan(container, function, init, combiner);
+            };
+
+            template<typename Left, typename Right>
+            static _joined<Left, Right> zip(const Left &left, const Right &right) {
+                return _::parallel::zip(left, right);
+            };
+
+            template<typename Left, typename Right, typename LeftKey, typename RightKey>
+            static _joined<Left, Right> join(const Left &left, const Right &right, LeftKey leftKey,
+                                             RightKey rightKey) {
+                return _::parallel::join(left, right, leftKey, rightKey);
+            };
+
+            template<typename Left, typename Right, typename LeftKey, typename RightKey>
+            static _joined<Left, Right> leftJoin(const Left &left, const Right &right, LeftKey leftKey,
+                                                 RightKey rightKey, const typename Right::value_type &otherwise) {
+                return _::parallel::leftJoin(left, right, leftKey, rightKey, otherwise);
+            };
+
+            template<typename Container, typename KeyFunction>
+            static _collected<Container> uniqBy(const Container &container, KeyFunction keyFunction) {
+                return _::parallel::uniqBy(container, keyFunction);
+            };
+
+            template<typename Container>
+            static _collected<Container> uniq(const Container &container) {
+                return _::parallel::uniq(container);
+            };
+
+            template<typename Container, typename Stage, typename Sink>
+            static std::vector<Sink> pipe(const Container &container, const Stage &stage, const Sink &sink) {
+                return _::parallel::pipe(container, stage, sink);
+            }
+        };
+    }
+
+    using Serial = _::strategy::Serial;
+    using Parallel = _::strategy::Parallel;
+
+    template<typename Container, typename StrategyType>
+    class Wrapper {
+
+    public:
+        //  ctx, if given, is the parallel::context every step runs on; it
+        //  must outlive the chain.
+        Wrapper(const Container &container, const parallel::context *ctx = nullptr)
+                : container(container), ctx(ctx) {}
+
+        Wrapper(Container &&container, const parallel::context *ctx = nullptr)
+                : container(std::move(container)), ctx(ctx) {}
+
+        Container value() const & {
+            return container;
+        }
+
+        //  a temporary chain hands its container out instead of copying it.
+        Container value() && {
+            return std::move(container);
+        }
+
+        template<typename Strategy=StrategyType, typename Function>
+        void each(Function function) {
+            parallel::scoped_context scope(ctx);
+            Strategy::each(container, function);
+        }
+
+        template<typename ResultContainer, typename Strategy=StrategyType, typename Function>
+        Wrapper<ResultContainer, StrategyType> map(Function function) const & {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<ResultContainer, StrategyType>(
+                    Strategy::template map<ResultContainer>(container, function), ctx);
+        };
+
+        //  a temporary chain hands its container to the step, which reuses
+        //  its storage where it can.
+        template<typename ResultContainer, typename Strategy=StrategyType, typename Function>
+        Wrapper<ResultContainer, StrategyType> map(Function function) && {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<ResultContainer, StrategyType>(
+                    Strategy::template map<ResultContainer>(std::move(container), function), ctx);
+        };
+
+        template<typename Strategy=StrategyType, typename Function>
+        Wrapper<_collected<Container>, StrategyType> filter(Function function) const & {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<_collected<Container>, StrategyType>(Strategy::filter(container, function), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Function>
+        Wrapper<_collected<Container>, StrategyType> filter(Function function) && {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<_collected<Container>, StrategyType>(Strategy::filter(std::move(container), function), ctx);
+        }
+
+        template<typename GroupKey, typename Strategy=StrategyType, typename Function>
+        Wrapper<std::map<GroupKey, _collected<Container>>, StrategyType> group(Function function) {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::map<GroupKey, _collected<Container>>, StrategyType>(
+                    Strategy::template group<GroupKey>(container, function), ctx);
+        };
+
+        template<typename GroupKey, template<typename...> class Map, typename Strategy=StrategyType, typename Function>
+        Wrapper<Map<GroupKey, _collected<Container>>, StrategyType> group(Function function) {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<Map<GroupKey, _collected<Container>>, StrategyType>(
+                    Strategy::template group<GroupKey, Map>(container, function), ctx);
+        };
+
+        template<typename GroupKey, template<typename...> class Map = std::map, typename Strategy=StrategyType,
+                typename KeyFunction, typename Function, typename ResultType>
+        Wrapper<Map<GroupKey, ResultType>, StrategyType> groupReduce(KeyFunction keyFunction, Function function,
+                                                                      ResultType init) {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<Map<GroupKey, ResultType>, StrategyType>(
+                    Strategy::template groupReduce<GroupKey, Map>(container, keyFunction, function, init), ctx);
+        };
+
+        template<typename GroupKey, template<typename...> class Map = std::map, typename Strategy=StrategyType,
+                typename KeyFunction, typename Function, typename ResultType, typename Combiner>
+        Wrapper<Map<GroupKey, ResultType>, StrategyType> groupReduce(KeyFunction keyFunction, Function function,
+                                                                      ResultType init, Combiner combiner) {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<Map<GroupKey, ResultType>, StrategyType>(
+                    Strategy::template groupReduce<GroupKey, Map>(container, keyFunction, function, init, combiner), ctx);
+        };
+
+        template<typename GroupKey, template<typename...> class Map = std::map, typename Strategy=StrategyType,
+                typename KeyFunction>
+        Wrapper<Map<GroupKey, size_t>, StrategyType> countBy(KeyFunction keyFunction) {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<Map<GroupKey, size_t>, StrategyType>(
+                    Strategy::template countBy<GroupKey, Map>(container, keyFunction), ctx);
+        };
+
+        template<typename GroupKey, template<typename...> class Map = std::map, typename Strategy=StrategyType,
+                typename KeyFunction, typename ValueFunction>
+        Wrapper<Map<GroupKey, typename _result_of<Container, ValueFunction>::type>, StrategyType>
+        sumBy(KeyFunction keyFunction, ValueFunction valueFunction) {
+            using ResultType = Map<GroupKey, typename _result_of<Container, ValueFunction>::type>;
+            parallel::scoped_context scope(ctx);
+            return Wrapper<ResultType, StrategyType>(
+                    Strategy::template sumBy<GroupKey, Map>(container, keyFunction, valueFunction), ctx);
+        };
+
+        template<typename ResultType, typename Strategy=StrategyType, typename Function>
+        Wrapper<ResultType, StrategyType> reduce(Function function, ResultType init) {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<ResultType, StrategyType>(Strategy::reduce(container, function, init), ctx);
+        };
+
+        template<typename ResultType, typename Strategy=StrategyType, typename Function, typename Combiner>
+        Wrapper<ResultType, StrategyType> reduce(Function function, ResultType init, Combiner combiner) {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<ResultType, StrategyType>(Strategy::reduce(container, function, init, combiner), ctx);
+        };
+
+        template<typename ResultType, typename Strategy=StrategyType>
+        Wrapper<ResultType, StrategyType> flatten() {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<ResultType, StrategyType>(Strategy::template flatten<Container>(container), ctx);
+        }
+
+        //  Items is Container, named so the value type is only needed when
+        //  the step is used.
+        template<typename Strategy=StrategyType, typename Items = Container,
+                typename Compare = std::less<typename Items::value_type>>
+        Wrapper<std::vector<typename Items::value_type>, StrategyType> sort(Compare compare = Compare()) const & {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<typename Items::value_type>, StrategyType>(
+                    Strategy::sort(container, compare), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container,
+                typename Compare = std::less<typename Items::value_type>>
+        Wrapper<std::vector<typename Items::value_type>, StrategyType> sort(Compare compare = Compare()) && {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<typename Items::value_type>, StrategyType>(
+                    Strategy::sort(std::move(container), compare), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container,
+                typename Compare = std::less<typename Items::value_type>>
+        Wrapper<std::vector<typename Items::value_type>, StrategyType>
+        stableSort(Compare compare = Compare()) const & {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<typename Items::value_type>, StrategyType>(
+                    Strategy::stableSort(container, compare), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container,
+                typename Compare = std::less<typename Items::value_type>>
+        Wrapper<std::vector<typename Items::value_type>, StrategyType> stableSort(Compare compare = Compare()) && {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<typename Items::value_type>, StrategyType>(
+                    Strategy::stableSort(std::move(container), compare), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container, typename KeyFunction>
+        Wrapper<std::vector<typename Items::value_type>, StrategyType> sortBy(KeyFunction keyFunction) const & {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<typename Items::value_type>, StrategyType>(
+                    Strategy::sortBy(container, keyFunction), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container, typename KeyFunction>
+        Wrapper<std::vector<typename Items::value_type>, StrategyType> sortBy(KeyFunction keyFunction) && {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<typename Items::value_type>, StrategyType>(
+                    Strategy::sortBy(std::move(container), keyFunction), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container,
+                typename Compare = std::greater<typename Items::value_type>>
+        Wrapper<std::vector<typename Items::value_type>, StrategyType> topK(size_t k,
+                                                                                 Compare compare = Compare()) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<typename Items::value_type>, StrategyType>(
+                    Strategy::topK(container, k, compare), ctx);
+        }
+
+        //  the first match, or otherwise if there is none.
+        template<typename Strategy=StrategyType, typename Items = Container, typename Function>
+        Wrapper<typename Items::value_type, StrategyType> find(Function function,
+                                                               typename Items::value_type otherwise
+                                                               = typename Items::value_type()) const {
+            parallel::scoped_context scope(ctx);
+            auto found = Strategy::find(container, function);
+            return Wrapper<typename Items::value_type, StrategyType>(found == container.end() ? otherwise : *found,
+                                                                     ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Function>
+        Wrapper<size_t, StrategyType> findIndex(Function function) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<size_t, StrategyType>(Strategy::findIndex(container, function), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Function>
+        Wrapper<bool, StrategyType> some(Function function) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<bool, StrategyType>(Strategy::some(container, function), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Function>
+        Wrapper<bool, StrategyType> every(Function function) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<bool, StrategyType>(Strategy::every(container, function), ctx);
+        }
+
+        template<typename ResultType, typename Strategy=StrategyType, typename Function>
+        Wrapper<std::vector<ResultType>, StrategyType> scan(Function function, ResultType init) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<ResultType>, StrategyType>(Strategy::scan(container, function, init), ctx);
+        }
+
+        template<typename ResultType, typename Strategy=StrategyType, typename Function, typename Combiner>
+        Wrapper<std::vector<ResultType>, StrategyType> scan(Function function, ResultType init,
+                                                            Combiner combiner) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<ResultType>, StrategyType>(
+                    Strategy::scan(container, function, init, combiner), ctx);
+        }
+
+        template<typename ResultType, typename Strategy=StrategyType, typename Function>
+        Wrapper<std::vector<ResultType>, StrategyType> exclusiveScan(Function function, ResultType init) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<ResultType>, StrategyType>(
+                    Strategy::exclusiveScan(container, function, init), ctx);
+        }
+
+        template<typename ResultType, typename Strategy=StrategyType, typename Function, typename Combiner>
+        Wrapper<std::vector<ResultType>, StrategyType> exclusiveScan(Function function, ResultType init,
+                                                                     Combiner combiner) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<std::vector<ResultType>, StrategyType>(
+                    Strategy::exclusiveScan(container, function, init, combiner), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container, typename Other>
+        Wrapper<_joined<Items, Other>, StrategyType> zip(const Other &other) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<_joined<Items, Other>, StrategyType>(Strategy::zip(container, other), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container, typename Other, typename LeftKey,
+                typename RightKey>
+        Wrapper<_joined<Items, Other>, StrategyType> join(const Other &other, LeftKey leftKey,
+                                                          RightKey rightKey) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<_joined<Items, Other>, StrategyType>(
+                    Strategy::join(container, other, leftKey, rightKey), ctx);
+        }
+
+        //  items without a match in other are paired with otherwise.
+        template<typename Strategy=StrategyType, typename Items = Container, typename Other, typename LeftKey,
+                typename RightKey>
+        Wrapper<_joined<Items, Other>, StrategyType> leftJoin(const Other &other, LeftKey leftKey, RightKey rightKey,
+                                                              const typename Other::value_type &otherwise
+                                                              = typename Other::value_type()) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<_joined<Items, Other>, StrategyType>(
+                    Strategy::leftJoin(container, other, leftKey, rightKey, otherwise), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container>
+        Wrapper<_collected<Items>, StrategyType> uniq() const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<_collected<Items>, StrategyType>(Strategy::uniq(container), ctx);
+        }
+
+        template<typename Strategy=StrategyType, typename Items = Container, typename KeyFunction>
+        Wrapper<_collected<Items>, StrategyType> uniqBy(KeyFunction keyFunction) const {
+            parallel::scoped_context scope(ctx);
+            return Wrapper<_collected<Items>, StrategyType>(Strategy::uniqBy(container, keyFunction), ctx);
+        }
+
+    private:
+        Container container;
+        const parallel::context *ctx;
+    };
+
+    //  chain(std::move(container)) takes the container over without copying.
+    template<typename StrategyType=Serial, typename Container>
+    Wrapper<typename std::decay<Container>::type, StrategyType> chain(Container &&container) {
+        return Wrapper<typename std::decay<Container>::type, StrategyType>(std::forward<Container>(container));
+    }
+
+    template<typename StrategyType=Serial, typename Container>
+    Wrapper<typename std::decay<Container>::type, StrategyType> chain(Container &&container,
+                                                                      const parallel::context &ctx) {
+        return Wrapper<typename std::decay<Container>::type, StrategyType>(std::forward<Container>(container), &ctx);
+    }
+
+    //  parallel primitives that return a future instead of blocking. each
+    //  runs as one task on a worker of the caller's pool, with the caller's
+    //  pool, partitioner and arena in scope, and still splits its work
+    //  over the pool, so independent calls share the workers. called from
+    //  a worker, or on a pool without workers, they run before returning.
+    //  the container must outlive the future.
+    namespace async {
+
+        //  the task runs on the calling thread when the pool has no workers,
+        //  which would never take it, or when the caller is a worker, which
+        //  may wait for a task queued behind itself. with onlyIfIdle it also
+        //  runs there unless a worker is free to take it at once.
+        template<typename Function>
+        std::future<decltype(std::declval<Function &>()())> _submit(Function task, bool onlyIfIdle = false) {
+            using result_type = decltype(std::declval<Function &>()());
+            parallel::thread_pool *pool = &parallel::current_pool();
+            parallel::partitioner partition = parallel::current_partitioner();
+            arena *scope = _current_arena();
+            auto job = std::make_shared<std::packaged_task<result_type()>>([pool, partition, scope, task]() {
+                parallel::scoped_pool scoped_pool(*pool);
+                parallel::scoped_partitioner scoped_partitioner(partition);
+                scoped_arena scoped(scope);
+                return task();
+            });
+            auto future = job->get_future();
+            bool queued = false;
+            if (pool->size() > 0 && !pool->is_worker()) {
+                if (onlyIfIdle) {
+                    queued = pool->try_submit([job]() { (*job)(); });
+                } else {
+                    pool->submit([job]() { (*job)(); });
+                    queued = true;
+                }
+            }
+            if (!queued) {
+                (*job)();
+            }
+            return future;
+        }
+
+        template<typename ResultContainer, typename Container, typename Function>
+        std::future<ResultContainer> map(const Container &container, Function function) {
+            return _submit([&container, function]() -> ResultContainer {
+                return parallel::map<ResultContainer>(container, function);
+            });
+        };
+
+        template<typename Container, typename Function>
+        std::future<_collected<Container>> filter(const Container &container, Function function) {
+            return _submit([&container, function]() -> _collected<Container> {
+                return parallel::filter(container, function);
+            });
+        };
+
+        template<typename GroupKey, typename Container, typename Function>
+        std::future<std::map<GroupKey, _collected<Container>>> group(const Container &container, Function function) {
+            return _submit([&container, function]() -> std::map<GroupKey, _collected<Container>> {
+                return parallel::group<GroupKey>(container, function);
+            });
+        };
+
+        template<typename ResultType, typename Container, typename Function>
+        std::future<ResultType> reduce(const Container &container, Function function, ResultType init) {
+            return _submit([&container, function, init]() -> ResultType {
+                return parallel::reduce(container, function, init);
+            });
+        };
+
+        template<typename ResultType, typename Container, typename Function, typename Combiner>
+        std::future<ResultType> reduce(const Container &container, Function function, ResultType init,
+                                       Combiner combiner) {
+            return _submit([&container, function, init, combiner]() -> ResultType {
+                return parallel::reduce(container, function, init, combiner);
+            });
+        };
+    }
+
+    //  a chain whose steps are recorded and run, in order, as one task when
+    //  value() is called. value() returns the future of the result and may
+    //  be called once.
+    template<typename Container, typename StrategyType>
+    class AsyncWrapper {
+    public:
+        AsyncWrapper(std::function<Container()> producer, const parallel::context *ctx = nullptr)
+                : producer(std::move(producer)), ctx(ctx) {}
+
+        template<typename Function>
+        AsyncWrapper each(Function function) const {
+            auto producer = this->producer;
+            return AsyncWrapper([producer, function]() -> Container {
+                Container container = producer();
+                StrategyType::each(container, function);
+                return container;
+            }, ctx);
+        }
+
+        template<typename ResultContainer, typename Function>
+        AsyncWrapper<ResultContainer, StrategyType> map(Function function) const {
+            auto producer = this->producer;
+            return AsyncWrapper<ResultContainer, StrategyType>([producer, function]() -> ResultContainer {
+                return StrategyType::template map<ResultContainer>(producer(), function);
+            }, ctx);
+        };
+
+        template<typename Function>
+        AsyncWrapper<_collected<Container>, StrategyType> filter(Function function) const {
+            auto producer = this->producer;
+            return AsyncWrapper<_collected<Container>, StrategyType>([producer, function]() -> _collected<Container> {
+                return StrategyType::filter(producer(), function);
+            }, ctx);
+        }
+
+        template<typename GroupKey, typename Function>
+        AsyncWrapper<std::map<GroupKey, _collected<Container>>, StrategyType> group(Function function) const {
+            using ResultType = std::map<GroupKey, _collected<Container>>;
+            auto producer = this->producer;
+            return AsyncWrapper<ResultType, StrategyType>([producer, function]() -> ResultType {
+                return StrategyType::template group<GroupKey>(producer(), function);
+            }, ctx);
+        };
+
+        template<typename ResultType, typename Function, typename Combiner>
+        AsyncWrapper<ResultType, StrategyType> reduce(Function function, ResultType init, Combiner combiner) const {
+            auto producer = this->producer;
+            return AsyncWrapper<ResultType, StrategyType>([producer, function, init, combiner]() -> ResultType {
+                return StrategyType::reduce(producer(), function, init, combiner);
+            }, ctx);
+        };
+
+        template<typename ResultType, typename Function>
+        AsyncWrapper<ResultType, StrategyType> reduce(Function function, ResultType init) const {
+            auto producer = this->producer;
+            return AsyncWrapper<ResultType, StrategyType>([producer, function, init]() -> ResultType {
+                return StrategyType::reduce(producer(), function, init);
+            }, ctx);
+        };
+
+        std::future<Container> value() const {
+            parallel::scoped_context scope(ctx);
+            return async::_submit(producer);
+        }
+
+    private:
+        std::function<Container()> producer;
+        const parallel::context *ctx;
+    };
+
+    namespace async {
+
+        template<typename StrategyType, typename Container>
+        AsyncWrapper<typename std::decay<Container>::type, StrategyType> _chain(Container &&container,
+                                                                            const parallel::context *ctx) {
+            using ContainerType = typename std::decay<Container>::type;
+            auto source = std::make_shared<ContainerType>(std::forward<Container>(container));
+            return AsyncWrapper<ContainerType, StrategyType>([source]() -> ContainerType {
+                return std::move(*source);
+            }, ctx);
+        }
+
+        //  like _::chain, the chain copies the container unless it is moved in.
+        template<typename StrategyType=Serial, typename Container>
+        AsyncWrapper<typename std::decay<Container>::type, StrategyType> chain(Container &&container) {
+            return _chain<StrategyType>(std::forward<Container>(container), nullptr);
+        }
+
+        template<typename StrategyType=Serial, typename Container>
+        AsyncWrapper<typename std::decay<Container>::type, StrategyType> chain(Container &&container,
+                                                                           const parallel::context &ctx) {
+            return _chain<StrategyType>(std::forward<Container>(container), &ctx);
+        }
+    }
+
+    //  stages of a lazy chain. push(item, sink) runs one item through all
+    //  stages composed so far and hands what comes out to sink.
+    struct _source_stage {
+
+        template<typename Item, typename Sink>
+        void push(const Item &item, Sink &sink) const {
+            sink(item);
+        }
+    };
+
+    template<typename Value, typename Function, typename Sink>
+    struct _map_sink {
+        const Function &function;
+        Sink &sink;
+
+        template<typename Item>
+        void operator()(const Item &item) {
+            Value value = function(item);
+            sink(value);
+        }
+    };
+
+    template<typename Stage, typename Value, typename Function>
+    struct _map_stage {
+        Stage stage;
+        Function function;
+
+        template<typename Item, typename Sink>
+        void push(const Item &item, Sink &sink) const {
+            _map_sink<Value, Function, Sink> next{function, sink};
+            stage.push(item, next);
+        }
+    };
+
+    template<typename Function, typename Sink>
+    struct _filter_sink {
+        const Function &function;
+        Sink &sink;
+
+        template<typename Item>
+        void operator()(const Item &item) {
+            if (function(item)) {
+                sink(item);
+            }
+        }
+    };
+
+    template<typename Stage, typename Function>
+    struct _filter_stage {
+        Stage stage;
+        Function function;
 
-    using namespace std;
+        template<typename Item, typename Sink>
+        void push(const Item &item, Sink &sink) const {
+            _filter_sink<Function, Sink> next{function, sink};
+            stage.push(item, next);
+        }
+    };
 
-    template<typename Container, typename Function>
-    void each(const Container &container, Function function) {
-        for (const auto &item : container) {
+    template<typename Function, typename Sink>
+    struct _each_sink {
+        const Function &function;
+        Sink &sink;
+
+        template<typename Item>
+        void operator()(const Item &item) {
             function(item);
+            sink(item);
         }
     };
 
-    template<typename ResultContainer, typename Container, typename Function>
-    ResultContainer map(const Container &container, Function function) {
-        ResultContainer result;
-        for (const auto &item : container) {
-            result.push_back(function(item));
+    template<typename Stage, typename Function>
+    struct _each_stage {
+        Stage stage;
+        Function function;
+
+        template<typename Item, typename Sink>
+        void push(const Item &item, Sink &sink) const {
+            _each_sink<Function, Sink> next{function, sink};
+            stage.push(item, next);
         }
-        return std::move(result);
     };
 
-    template<typename Container, typename Function>
-    Container filter(const Container &container, Function function) {
+    //  what a lazy chain materializes into, one per chunk.
+    struct _discard_sink {
+
+        template<typename Item>
+        void operator()(const Item &item) {}
+    };
+
+    template<typename Container>
+    struct _push_back_sink {
         Container result;
-        for (const auto &item : container) {
-            if (function(item)) {
-                result.push_back(item);
-            }
+
+        template<typename Item>
+        void operator()(const Item &item) {
+            result.push_back(item);
+        }
+    };
+
+    template<typename ResultType, typename Function>
+    struct _fold_sink {
+        Function function;
+        ResultType result;
+
+        template<typename Item>
+        void operator()(const Item &item) {
+            result = function(result, item);
         }
-        return std::move(result);
     };
 
     template<typename GroupKey, typename Container, typename Function>
-    std::map<GroupKey, Container> group(const Container &container, Function function) {
+    struct _group_sink {
+        Function function;
         std::map<GroupKey, Container> result;
-        _::each(container, [&result, &function](const typename Container::value_type &item) {
-            GroupKey key = function(item);
-            if (result.find(key) == result.end()) {
-                Container tmpC;
-                tmpC.push_back(item);
-                result[key] = tmpC;
-            } else {
-                result[key].push_back(item);
-            }
-        });
-        return std::move(result);
-    };
 
-    template<typename ResultType, typename Container, typename Function>
-    ResultType reduce(const Container &container, Function function, ResultType init) {
-        ResultType result = init;
-        each(container, [&result, &function](const typename Container::value_type &item) {
-            result = function(result, item);
-        });
-        return std::move(result);
+        template<typename Item>
+        void operator()(const Item &item) {
+            result[function(item)].push_back(item);
+        }
     };
 
-    template<typename ContainerOfContainer>
-    typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
-        typename ContainerOfContainer::value_type result;
-        for (const auto &container : containerOfContainer) {
-            for (const auto &item : container) {
-                result.push_back(item);
-            }
+    template<typename Container>
+    void _append(Container &to, const Container &from) {
+        for (const auto &item : from) {
+            to.push_back(item);
         }
-        return std::move(result);
     }
-}
-
-namespace _ {
-
-    namespace parallel {
 
-        inline unsigned int get_concurrency() {
-            return std::thread::hardware_concurrency();
-        }
+    //  a chain whose map, filter and each steps are only recorded. value(),
+    //  reduce() and group() run all of them in one pass over the source,
+    //  once per chunk under Parallel, without intermediate containers.
+    //  the source container must outlive the chain, so lazy() does not
+    //  take temporaries.
+    template<typename Source, typename Container, typename StrategyType, typename Stage>
+    class LazyWrapper {
 
-        class atomic_spin_lock {
-        private:
-            enum STATUS {
-                UNLOCKED = 0,
-                LOCKED = 1
-            };
-        public:
-            void lock() {
-                int desired = UNLOCKED;
-                while (!_lock.compare_exchange_strong(desired, LOCKED)) {
-                    desired = UNLOCKED;
-                }
-            }
+        template<typename NextStage>
+        using Next = LazyWrapper<Source, Container, StrategyType, NextStage>;
 
-            void unlock() {
-                _lock.store(UNLOCKED);
-            }
+    public:
+        LazyWrapper(const Source &source, Stage stage, const parallel::context *ctx = nullptr)
+                : source(source), stage(stage), ctx(ctx) {}
 
-        private:
-            std::atomic<int> _lock{0};
+        template<typename ResultContainer, typename Function>
+        LazyWrapper<Source, ResultContainer, StrategyType,
+                _map_stage<Stage, typename ResultContainer::value_type, Function>> map(Function function) const {
+            using NextStage = _map_stage<Stage, typename ResultContainer::value_type, Function>;
+            return LazyWrapper<Source, ResultContainer, StrategyType, NextStage>(source, NextStage{stage, function}, ctx);
         };
 
-        template<typename Container>
-        struct _peach_selector {
-            static void each(const Container &container,
-                             std::function<void(size_t tid, size_t idx,
-                                                const typename Container::value_type &elem)> function) {
-                const int THREADS = get_concurrency();
-#ifdef _DEBUG
-                std::cout << "underscore: parallel with " << N_THREADS << " threads." << std::endl;
-#endif
-                size_t idx = 0;
-                auto itr = container.begin();
-                auto end = container.end();
+        template<typename Function>
+        Next<_filter_stage<Stage, Function>> filter(Function function) const {
+            return Next<_filter_stage<Stage, Function>>(source, _filter_stage<Stage, Function>{stage, function}, ctx);
+        }
 
-                atomic_spin_lock _lock;
+        template<typename Function>
+        Next<_each_stage<Stage, Function>> each(Function function) const {
+            return Next<_each_stage<Stage, Function>>(source, _each_stage<Stage, Function>{stage, function}, ctx);
+        }
 
-                std::thread **threads = new thread *[THREADS];
-                for (size_t i = 0; i < THREADS; i++) {
-                    threads[i] = new thread([&function, &idx, i, &_lock, &itr, &end]() {
+        //  runs the recorded steps for their side effects only.
+        void run() const {
+            parallel::scoped_context scope(ctx);
+            StrategyType::pipe(source, stage, _discard_sink());
+        }
 
-                        while (true) {
-                            //  get itr first
-                            _lock.lock();
-                            if (itr == end) {
-                                _lock.unlock();
-                                break;
-                            } else {
-                                auto local_itr = itr;
-                                auto local_idx = idx;
-                                itr++;
-                                idx++;
-                                _lock.unlock();
-                                function(i, local_idx, *local_itr);
-                            }
-                        }
-                    });
-                }
-                for (int i = 0; i < THREADS; i++) {
-                    threads[i]->join();
-                    delete threads[i];
-                }
-                delete[] threads;
+        Container value() const {
+            parallel::scoped_context scope(ctx);
+            auto sinks = StrategyType::pipe(source, stage, _push_back_sink<Container>());
+            std::vector<Container> parts;
+            parts.reserve(sinks.size());
+            for (auto &sink : sinks) {
+                parts.push_back(std::move(sink.result));
             }
-        };
-
-        template<typename ValueType>
-        struct _peach_selector<std::vector<ValueType>> {
-
-            using Container = std::vector<ValueType>;
-
-            static void each(const Container &container,
-                             std::function<void(size_t tid, size_t idx,
-                                                const typename Container::value_type &elem)> function) {
-                const int THREADS = get_concurrency();
-#ifdef _DEBUG
-                std::cout << "underscore: parallel with " << N_THREADS << " threads." << std::endl;
-#endif
-
-                size_t size = container.size();
-                std::thread **threads = new thread *[THREADS];
-                for (size_t i = 0; i < THREADS; i++) {
-                    threads[i] = new thread([&function, &container, size, i, THREADS]() {
-                        auto start = i * size / THREADS;
-                        auto end = std::min((i + 1) * size / THREADS, size);
-                        for (auto j = start; j < end; j++) {
-                            function(i, j, container[j]);
-                        }
-                    });
-                }
-                for (int i = 0; i < THREADS; i++) {
-                    threads[i]->join();
-                    delete threads[i];
-                }
-                delete[] threads;
+            if (parts.empty()) {
+                return Container();
             }
-        };
-
-        template<typename Container>
-        void _peach(const Container &container,
-                    std::function<void(size_t tid, size_t idx, const typename Container::value_type &elem)> function) {
-            _peach_selector<Container>::each(container, function);
-        };
+            return _::parallel::_concat(parts);
+        }
 
-        template<typename Container, typename Function>
-        void each(const Container &container, Function function) {
-            _peach<Container>(container,
-                              [&function](size_t i, size_t j, const typename Container::value_type &elem) {
-                                  function(elem);
-                              });
+        //  chunks fold from init and are joined with combiner, so init must
+        //  be an identity for function.
+        template<typename ResultType, typename Function, typename Combiner>
+        Wrapper<ResultType, StrategyType> reduce(Function function, ResultType init, Combiner combiner) const {
+            parallel::scoped_context scope(ctx);
+            auto sinks = StrategyType::pipe(source, stage, _fold_sink<ResultType, Function>{function, init});
+            if (sinks.empty()) {
+                return Wrapper<ResultType, StrategyType>(init, ctx);
+            }
+            ResultType result = sinks[0].result;
+            for (size_t i = 1; i < sinks.size(); i++) {
+                result = combiner(result, sinks[i].result);
+            }
+            return Wrapper<ResultType, StrategyType>(result, ctx);
         };
 
-        template<typename ResultContainer, typename Container, typename Function>
-        ResultContainer map(const Container &container, Function function) {
-            ResultContainer result(container.size());
-            _peach(container, [&result, &function, &container](size_t tid, size_t idx,
-                                                               const typename Container::value_type &elem) {
-                result[idx] = function(elem);
-            });
-            return std::move(result);
+        //  without a combiner the steps and the fold run in one serial pass.
+        template<typename ResultType, typename Function>
+        Wrapper<ResultType, StrategyType> reduce(Function function, ResultType init) const {
+            parallel::scoped_context scope(ctx);
+            auto sinks = Serial::pipe(source, stage, _fold_sink<ResultType, Function>{function, init});
+            return Wrapper<ResultType, StrategyType>(sinks[0].result, ctx);
         };
 
-        template<typename Container, typename Function>
-        Container filter(const Container &container, Function function) {
-            Container result;
-            std::mutex _mutex;
-            _peach(container, [&result, &_mutex, &container, &function](size_t tid, size_t idx,
-                                                                        const typename Container::value_type &elem) {
-                if (function(elem)) {
-                    _mutex.lock();
-                    result.push_back(elem);
-                    _mutex.unlock();
+        template<typename GroupKey, typename Function>
+        Wrapper<std::map<GroupKey, Container>, StrategyType> group(Function function) const {
+            using ResultType = std::map<GroupKey, Container>;
+            parallel::scoped_context scope(ctx);
+            auto sinks = StrategyType::pipe(source, stage,
+                                            _group_sink<GroupKey, Container, Function>{function, ResultType()});
+            if (sinks.size() == 1) {
+                return Wrapper<ResultType, StrategyType>(sinks[0].result, ctx);
+            }
+            ResultType result;
+            for (const auto &sink : sinks) {
+                for (const auto &pair : sink.result) {
+                    _append(result[pair.first], pair.second);
                 }
-            });
-            return std::move(result);
+            }
+            return Wrapper<ResultType, StrategyType>(result, ctx);
         };
 
-        template<typename KeyType, typename ValueType>
-        std::map<KeyType, std::vector<ValueType>>
-        merge(const std::vector<std::map<KeyType, std::vector<ValueType>>> &temp) {
+    private:
+        const Source &source;
+        Stage stage;
+        const parallel::context *ctx;
+    };
 
-            using ValueContainer = std::vector<ValueType>;
-            using ResultType =std::map<KeyType, ValueContainer>;
-            using KeysType = std::vector<KeyType>;
+    template<typename StrategyType=Serial, typename Container>
+    LazyWrapper<Container, _collected<Container>, StrategyType, _source_stage> lazy(const Container &container) {
+        return LazyWrapper<Container, _collected<Container>, StrategyType, _source_stage>(container, _source_stage());
+    }
 
-            //  get all the grouped keys, put them into a vector
-            std::set<KeyType> tempKeys;
-            _::each(temp, [&tempKeys](const ResultType &item) {
-                for (const auto &pair : item) {
-                    tempKeys.insert(pair.first);
-                }
-            });
-            ResultType result;
-            auto keys = _::map < KeysType > (tempKeys,
-                    [&result](const KeyType &key) -> KeyType {
-                        result[key] = ValueContainer();
-                        return key;
-                    });
+    template<typename StrategyType=Serial, typename Container>
+    LazyWrapper<Container, _collected<Container>, StrategyType, _source_stage> lazy(const Container &container,
+                                                                                    const parallel::context &ctx) {
+        return LazyWrapper<Container, _collected<Container>, StrategyType, _source_stage>(
+                container, _source_stage(), &ctx);
+    }
 
-            //  parallel reduce temp maps into single. paralleled by keys
-            each(keys, [&result, &temp](const KeyType &key) {
-                _::each(temp, [&key, &result](const ResultType &itemp) {
-                    auto &keySet = result[key];
-                    if (itemp.find(key) != itemp.end()) {
-                        auto &tset = const_cast<ResultType &>(itemp)[key];
-                        for (const auto &item : tset) {
-                            keySet.push_back(item);
-                        }
-                    }
-                });
-            });
-            return std::move(result);
-        };
+    //  the chain only refers to its source, so it can not be a temporary.
+    template<typename StrategyType=Serial, typename Container>
+    void lazy(const Container &&container) = delete;
 
-        template<typename GroupKey, typename Container, typename Function>
-        std::map<GroupKey, Container> group(const Container &container, Function function) {
-
-            using result_type = std::map<GroupKey, Container>;
-            const int THREADS = get_concurrency();
-
-            //  parallel group data to many temp maps.
-            std::vector<result_type> temp((size_t) THREADS);
-            _peach(container, [&temp, &function](size_t tid, size_t idx, const typename Container::value_type &elem) {
-                const auto &item = elem;
-                auto &ttemp = temp[tid];
-                GroupKey key = function(item);
-                if (ttemp.find(key) == ttemp.end()) {
-                    Container tmpC;
-                    tmpC.push_back(item);
-                    ttemp[key] = tmpC;
-                } else {
-                    ttemp[key].push_back(item);
-                }
-            });
+    template<typename StrategyType=Serial, typename Container>
+    void lazy(const Container &&container, const parallel::context &ctx) = delete;
 
-            return merge(temp);
-        };
+    //  readers pull the records of a stream one at a time: next(item)
+    //  stores the next record in item, or returns false at the end.
+    template<typename Iterator>
+    struct _iterator_reader {
+        using value_type = typename std::iterator_traits<Iterator>::value_type;
 
-        template<typename ContainerOfContainer>
-        typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
+        Iterator first;
+        Iterator last;
 
-            //  get ranges of each container in result
-            typedef std::tuple<size_t, size_t, size_t> range_type;
-            size_t total_size = 0;
-            std::vector<range_type> ranges(containerOfContainer.size());
-            for (size_t i = 0; i < containerOfContainer.size(); i++) {
-                ranges[i] = make_tuple(i, total_size, total_size + containerOfContainer[i].size());
-                total_size += containerOfContainer[i].size();
+        bool next(value_type &item) {
+            if (first == last) {
+                return false;
             }
-
-            //  perform parallel flatten
-            typename ContainerOfContainer::value_type result(total_size);
-            _peach(ranges, [&containerOfContainer, &ranges, &result](size_t tid, size_t idx, const range_type &range) {
-                size_t cid = std::get<0>(range);
-                size_t start = std::get<1>(range);
-                size_t end = std::get<2>(range);
-                for (size_t i = start; i < end; i++) {
-                    result[i] = (containerOfContainer[cid][i - start]);
-                }
-            });
-            return std::move(result);
+            item = *first;
+            ++first;
+            return true;
         }
-    }
-}
-
-namespace _ {
+    };
 
-    namespace strategy {
+    template<typename Item, typename Generator>
+    struct _generator_reader {
+        using value_type = Item;
 
-        struct Serial {
+        Generator generator;
 
-            template<typename Container, typename Function>
-            static void each(const Container &container, Function function) {
-                _::each(container, function);
-            };
+        bool next(Item &item) {
+            return generator(item);
+        }
+    };
 
-            template<typename ResultContainer, typename Container, typename Function>
-            static ResultContainer map(const Container &container, Function function) {
-                return _::map < ResultContainer > (container, function);
-            };
+    //  one record per line.
+    struct _line_reader {
+        using value_type = std::string;
 
-            template<typename Container, typename Function>
-            static Container filter(const Container &container, Function function) {
-                return _::filter(container, function);
-            };
+        std::istream *in;
 
-            template<typename GroupKey, typename Container, typename Function>
-            static std::map<GroupKey, Container> group(const Container &container, Function function) {
+        bool next(std::string &item) {
+            return (bool) std::getline(*in, item);
+        }
+    };
 
-                return _::group(container, function);
-            };
+    //  about how much memory a buffered record takes, for the memory cap.
+    template<typename T>
+    size_t _record_bytes(const T &item) {
+        return sizeof(T);
+    }
 
-            template<typename ResultType, typename Container, typename Function>
-            static ResultType reduce(const Container &container, Function function, ResultType init) {
-                return _::reduce(container, function, init);
-            };
+    inline size_t _record_bytes(const std::string &item) {
+        return sizeof(std::string) + item.capacity();
+    }
 
-            template<typename ContainerOfContainer>
-            static typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
+    const size_t STREAM_BATCH_SIZE = 1 << 16;
 
-                return _::flatten(containerOfContainer);
-            }
-        };
+    //  a lazy chain over a stream: records are read in batches of at most
+    //  batch() records, or fewer once they take memory() bytes, and each
+    //  batch runs through the recorded steps like a lazy chain over a
+    //  container. reduce() and group() fold every batch into their result
+    //  before the next one is read, so one batch is buffered at a time.
+    //  the stream is read once, by the first of run(), value(), reduce()
+    //  or group().
+    template<typename Reader, typename Container, typename StrategyType, typename Stage>
+    class StreamWrapper {
 
-        struct Parallel {
+        template<typename NextStage>
+        using Next = StreamWrapper<Reader, Container, StrategyType, NextStage>;
 
-            template<typename Container, typename Function>
-            static void each(const Container &container, Function function) {
-                _::parallel::each(container, function);
-            };
+        using batch_type = std::vector<typename Reader::value_type>;
 
-            template<typename ResultContainer, typename Container, typename Function>
-            static ResultContainer map(const Container &container, Function function) {
-                return _::parallel::map<ResultContainer>(container, function);
-            };
+    public:
+        StreamWrapper(Reader reader, Stage stage, size_t batch_size = STREAM_BATCH_SIZE, size_t memory_cap = 0,
+                      bool overlapped = false, const parallel::context *ctx = nullptr)
+                : reader(reader), stage(stage), batch_size(batch_size), memory_cap(memory_cap),
+                  overlapped(overlapped), ctx(ctx) {}
 
-            template<typename Container, typename Function>
-            static Container filter(const Container &container, Function function) {
-                return _::parallel::filter(container, function);
-            };
+        StreamWrapper batch(size_t items) const {
+            return StreamWrapper(reader, stage, std::max<size_t>(items, 1), memory_cap, overlapped, ctx);
+        }
 
-            template<typename GroupKey, typename Container, typename Function>
-            static std::map<GroupKey, Container> group(const Container &container, Function function) {
+        //  0 for no cap. a batch always holds at least one record.
+        StreamWrapper memory(size_t bytes) const {
+            return StreamWrapper(reader, stage, batch_size, bytes, overlapped, ctx);
+        }
 
-                return _::parallel::group(container, function);
-            };
+        //  reads the next batch while the current one runs through the
+        //  steps, so two batches are buffered at a time.
+        StreamWrapper pipeline(bool on = true) const {
+            return StreamWrapper(reader, stage, batch_size, memory_cap, on, ctx);
+        }
 
-            template<typename ResultType, typename Container, typename Function>
-            static ResultType reduce(const Container &container, Function function, ResultType init) {
-                return _::reduce(container, function, init);
-            };
+        //  runs the batches on ctx.
+        StreamWrapper on(const parallel::context &ctx) const {
+            return StreamWrapper(reader, stage, batch_size, memory_cap, overlapped, &ctx);
+        }
 
-            template<typename ContainerOfContainer>
-            static typename ContainerOfContainer::value_type flatten(ContainerOfContainer &containerOfContainer) {
-                return _::parallel::flatten(containerOfContainer);
-            }
+        template<typename ResultContainer, typename Function>
+        StreamWrapper<Reader, ResultContainer, StrategyType,
+                _map_stage<Stage, typename ResultContainer::value_type, Function>> map(Function function) const {
+            using NextStage = _map_stage<Stage, typename ResultContainer::value_type, Function>;
+            return StreamWrapper<Reader, ResultContainer, StrategyType, NextStage>(
+                    reader, NextStage{stage, function}, batch_size, memory_cap, overlapped, ctx);
         };
-    }
-
-    using Serial = _::strategy::Serial;
-    using Parallel = _::strategy::Parallel;
-
-    template<typename Container, typename StrategyType>
-    class Wrapper {
-
-        using WrapperType = Wrapper<Container, StrategyType>;
-
-    public:
-        Wrapper(const Container &container) : container(container) {}
 
-        Container value() const {
-            return container;
+        template<typename Function>
+        Next<_filter_stage<Stage, Function>> filter(Function function) const {
+            return Next<_filter_stage<Stage, Function>>(
+                    reader, _filter_stage<Stage, Function>{stage, function}, batch_size, memory_cap, overlapped, ctx);
         }
 
-        template<typename Strategy=StrategyType, typename Function>
-        void each(Function function) {
-            Strategy::each(container, function);
+        template<typename Function>
+        Next<_each_stage<Stage, Function>> each(Function function) const {
+            return Next<_each_stage<Stage, Function>>(
+                    reader, _each_stage<Stage, Function>{stage, function}, batch_size, memory_cap, overlapped, ctx);
         }
 
-        template<typename ResultContainer, typename Strategy=StrategyType, typename Function>
-        WrapperType map(Function function) {
-            return WrapperType(Strategy::template map<ResultContainer>(container, function));
-        };
+        void run() {
+            parallel::scoped_context scope(ctx);
+            _batches([this](const batch_type &batch) {
+                StrategyType::pipe(batch, stage, _discard_sink());
+            });
+        }
 
-        template<typename Strategy=StrategyType, typename Function>
-        WrapperType filter(Function function) {
-            return WrapperType(Strategy::filter(container, function));
+        Container value() {
+            parallel::scoped_context scope(ctx);
+            Container result;
+            _batches([this, &result](const batch_type &batch) {
+                for (auto &sink : StrategyType::pipe(batch, stage, _push_back_sink<Container>())) {
+                    _append(result, sink.result);
+                }
+            });
+            return result;
         }
 
-        template<typename GroupKey, typename Strategy=StrategyType, typename Function>
-        WrapperType group(Function function) {
-            return WrapperType(Strategy::group(container, function));
+        //  chunks of a batch fold from init and are joined with combiner,
+        //  so init must be an identity for function; the first partial
+        //  result starts the running one. under Serial the combiner is not
+        //  needed and the batches are folded as without one.
+        template<typename ResultType, typename Function, typename Combiner>
+        Wrapper<ResultType, StrategyType> reduce(Function function, ResultType init, Combiner combiner) {
+            if (std::is_same<StrategyType, Serial>::value) {
+                return reduce(function, init);
+            }
+            parallel::scoped_context scope(ctx);
+            ResultType result = init;
+            bool first = true;
+            _batches([this, &result, &first, &function, &init, &combiner](const batch_type &batch) {
+                for (auto &sink : StrategyType::pipe(batch, stage, _fold_sink<ResultType, Function>{function, init})) {
+                    result = first ? std::move(sink.result) : combiner(result, sink.result);
+                    first = false;
+                }
+            });
+            return Wrapper<ResultType, StrategyType>(result, ctx);
         };
 
-        template<typename ResultType, typename Strategy=StrategyType, typename Function>
+        //  without a combiner every batch is folded on this thread, starting
+        //  from the result of the batches before it.
+        template<typename ResultType, typename Function>
         Wrapper<ResultType, StrategyType> reduce(Function function, ResultType init) {
-            return Wrapper<ResultType, StrategyType>(Strategy::reduce(container, function, init));
+            parallel::scoped_context scope(ctx);
+            ResultType result = init;
+            _batches([this, &result, &function](const batch_type &batch) {
+                auto sinks = Serial::pipe(batch, stage, _fold_sink<ResultType, Function>{function, result});
+                result = std::move(sinks[0].result);
+            });
+            return Wrapper<ResultType, StrategyType>(result, ctx);
         };
 
-        template<typename ResultType, typename Strategy=StrategyType>
-        Wrapper<ResultType, StrategyType> flatten() {
-            return Wrapper<ResultType, StrategyType>(Strategy::template flatten<Container>(container));
-        }
+        template<typename GroupKey, typename Function>
+        Wrapper<std::map<GroupKey, Container>, StrategyType> group(Function function) {
+            using ResultType = std::map<GroupKey, Container>;
+            parallel::scoped_context scope(ctx);
+            ResultType result;
+            _batches([this, &result, &function](const batch_type &batch) {
+                auto sinks = StrategyType::pipe(batch, stage,
+                                                _group_sink<GroupKey, Container, Function>{function, ResultType()});
+                for (const auto &sink : sinks) {
+                    for (const auto &pair : sink.result) {
+                        _append(result[pair.first], pair.second);
+                    }
+                }
+            });
+            return Wrapper<ResultType, StrategyType>(result, ctx);
+        };
 
     private:
-        Container container;
+        //  reads the next batch into buffer, returns false once the stream
+        //  is done.
+        bool _fill(batch_type &buffer) {
+            buffer.clear();
+            size_t bytes = 0;
+            typename Reader::value_type item;
+            while (buffer.size() < batch_size && (memory_cap == 0 || bytes < memory_cap)) {
+                if (!reader.next(item)) {
+                    break;
+                }
+                bytes += _record_bytes(item);
+                buffer.push_back(std::move(item));
+            }
+            return !buffer.empty();
+        }
+
+        //  reads the stream batch by batch into reused buffers. consume
+        //  never runs for two batches at once.
+        template<typename Consume>
+        void _batches(Consume consume) {
+            batch_type current;
+            if (!overlapped) {
+                while (_fill(current)) {
+                    consume(current);
+                }
+                return;
+            }
+            batch_type next;
+            bool more = _fill(current);
+            while (more) {
+                //  consumed right here when no worker is free to overlap it
+                auto running = async::_submit([&consume, &current]() { consume(current); }, true);
+                try {
+                    more = _fill(next);
+                } catch (...) {
+                    running.wait();
+                    throw;
+                }
+                running.get();
+                std::swap(current, next);
+            }
+        }
+
+        Reader reader;
+        Stage stage;
+        size_t batch_size;
+        size_t memory_cap;
+        bool overlapped;
+        const parallel::context *ctx;
     };
 
-    template<typename StrategyType=Serial, typename Container>
-    Wrapper<Container, StrategyType> chain(const Container &container) {
-        return Wrapper<Container, StrategyType>(container);
+    template<typename Reader, typename StrategyType>
+    using _stream_of = StreamWrapper<Reader, std::vector<typename Reader::value_type>, StrategyType, _source_stage>;
+
+    //  streams [first, last), which may be single pass, e.g. istream_iterators.
+    template<typename StrategyType=Serial, typename Iterator>
+    _stream_of<_iterator_reader<Iterator>, StrategyType> stream(Iterator first, Iterator last) {
+        return _stream_of<_iterator_reader<Iterator>, StrategyType>(_iterator_reader<Iterator>{first, last},
+                                                                    _source_stage());
+    }
+
+    //  generator(item) stores the next record in item, or returns false at
+    //  the end.
+    template<typename StrategyType=Serial, typename Item, typename Generator>
+    _stream_of<_generator_reader<Item, Generator>, StrategyType> stream(Generator generator) {
+        return _stream_of<_generator_reader<Item, Generator>, StrategyType>(
+                _generator_reader<Item, Generator>{generator}, _source_stage());
+    }
+
+    //  streams the lines of in.
+    template<typename StrategyType=Serial>
+    _stream_of<_line_reader, StrategyType> stream(std::istream &in) {
+        return _stream_of<_line_reader, StrategyType>(_line_reader{&in}, _source_stage());
     }
 }
 
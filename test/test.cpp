@@ -1,5 +1,12 @@
 #include <iostream>
 #include <vector>
+#include <list>
+#include <iterator>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
 #include <cassert>
 #include "underscore.hpp"
 
@@ -74,6 +81,27 @@ namespace test {
         std::cout << "OK." << std::endl;
     }
 
+    void test_group_reduce() {
+
+        std::cout << "Testing groupReduce..." << std::endl;
+
+        std::vector<int> a{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        auto counts = _::countBy<bool>(a, [](const int &item) -> bool { return item % 2 == 0; });
+        assert(counts[true] == 5 && counts[false] == 5);
+
+        auto sums = _::sumBy<int>(a, [](const int &item) -> int { return item % 3; },
+                                  [](const int &item) -> long { return item; });
+        assert(sums[0] == 18 && sums[1] == 22 && sums[2] == 15);
+
+        auto maxes = _::chain(a)
+                .groupReduce<int>([](const int &item) -> int { return item % 3; },
+                                  [](int memo, const int &item) -> int { return std::max(memo, item); }, 0)
+                .value();
+        assert(maxes[0] == 9 && maxes[1] == 10 && maxes[2] == 8);
+
+        std::cout << "OK." << std::endl;
+    }
+
     void test_reduce() {
 
         std::cout << "Testing reduce..." << std::endl;
@@ -88,6 +116,47 @@ namespace test {
         std::cout << "OK." << std::endl;
     }
 
+    void test_numeric() {
+
+        std::cout << "Testing numeric kernels..." << std::endl;
+
+        std::vector<int> a;
+        std::vector<double> d;
+        for (int i = 1; i <= 1003; i++) {
+            a.push_back(i % 2 ? i : -i);
+            d.push_back(i * 0.5);
+        }
+        assert(_::sum(a) == 502);
+        assert(_::min(a) == -1002 && _::max(a) == 1003);
+        assert(_::sum(d) == 1003 * 1004 / 4.0);
+        assert(_::dot(d, d) == _::reduce(d, [](double memo, double item) -> double {
+            return memo + item * item;
+        }, 0.0));
+        assert(_::reduce(a, std::plus<int>(), 2) == 504);
+
+        //  int products widen to 64 bits before they are added
+        std::vector<int> big(a.size());
+        long long expected = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            big[i] = (i % 3 ? 1 : -1) * 2000000000 + (int) i;
+            expected += (long long) a[i] * big[i];
+        }
+        assert(_::dot(a, big) == expected);
+
+        auto scaled = _::map<std::vector<double>>(d, _::ops::multiply(2.0));
+        auto shifted = _::map<std::vector<int>>(a, _::ops::add(1));
+        auto offset = _::map<std::vector<double>>(std::vector<double>{1.5, 2.5, 3.75}, _::ops::add(2));
+        assert(offset[0] == 3.5 && offset[1] == 4.5 && offset[2] == 5.75);
+        for (size_t i = 0; i < a.size(); i++) {
+            assert(scaled[i] == d[i] * 2 && shifted[i] == a[i] + 1);
+        }
+
+        std::list<float> l{3, 1, 2};
+        assert(_::sum(l) == 6 && _::min(l) == 1 && _::max(l) == 3);
+
+        std::cout << "OK." << std::endl;
+    }
+
     void test_flatten() {
 
         std::cout << "Testing flatten..." << std::endl;
@@ -107,6 +176,140 @@ namespace test {
         std::cout << "OK." << std::endl;
     }
 
+    void test_into() {
+
+        std::cout << "Testing output iterator sinks..." << std::endl;
+
+        std::list<int> a{1, 2, 3, 4, 5};
+        int buffer[5];
+        int *end = _::map_into(a, buffer, [](const int &item) -> int { return item * 2; });
+        assert(end == buffer + 5 && buffer[0] == 2 && buffer[4] == 10);
+
+        std::vector<int> evens;
+        _::filter_into(a, std::back_inserter(evens), [](const int &item) -> bool { return item % 2 == 0; });
+        assert((evens == std::vector<int>{2, 4}));
+
+        std::vector<std::vector<int>> nested{{1, 2}, {}, {3}};
+        std::vector<int> flat(3);
+        assert(_::flatten_into(nested, flat.begin()) == flat.end());
+        assert((flat == std::vector<int>{1, 2, 3}));
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_arena() {
+
+        std::cout << "Testing arena allocation..." << std::endl;
+
+        _::arena arena;
+        void *first = arena.allocate(16, 8);
+        arena.release();
+        assert(arena.allocate(16, 8) == first);
+        arena.release();
+
+        for (int batch = 0; batch < 3; batch++) {
+            _::scoped_arena scope(arena);
+            _::arena_vector<int> a;
+            for (int i = 1; i <= 1000; i++) {
+                a.push_back(i);
+            }
+            auto evens = _::filter(a, [](const int &item) -> bool { return item % 2 == 0; });
+            assert(evens.size() == 500 && evens.get_allocator() == a.get_allocator());
+            auto groups = _::group<int, _::arena_map>(a, [](const int &item) -> int { return item % 10; });
+            assert(groups.size() == 10 && groups[3].size() == 100);
+        }
+        arena.release();
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_sort() {
+
+        std::cout << "Testing sort..." << std::endl;
+
+        std::list<int> a{3, 1, 4, 1, 5, 9, 2, 6};
+        assert((_::sort(a) == std::vector<int>{1, 1, 2, 3, 4, 5, 6, 9}));
+        assert((_::sort(a, std::greater<int>()) == std::vector<int>{9, 6, 5, 4, 3, 2, 1, 1}));
+        assert((_::topK(a, 3) == std::vector<int>{9, 6, 5}));
+        assert((_::topK(a, 2, std::less<int>()) == std::vector<int>{1, 1}));
+        assert(_::topK(a, 0).empty() && _::topK(a, 100).size() == 8);
+
+        std::vector<std::string> words{"pear", "fig", "apple", "kiwi", "plum"};
+        auto by_length = _::sortBy(words, [](const std::string &item) -> size_t { return item.size(); });
+        assert((by_length == std::vector<std::string>{"fig", "pear", "kiwi", "plum", "apple"}));
+
+        auto sorted = _::chain(std::move(words)).stableSort().value();
+        assert((sorted == std::vector<std::string>{"apple", "fig", "kiwi", "pear", "plum"}));
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_search() {
+
+        std::cout << "Testing search..." << std::endl;
+
+        std::list<int> a{3, 1, 4, 1, 5, 9, 2, 6};
+        assert(*_::find(a, [](const int &item) -> bool { return item > 3; }) == 4);
+        assert(_::find(a, [](const int &item) -> bool { return item > 9; }) == a.end());
+        assert(_::findIndex(a, [](const int &item) -> bool { return item == 1; }) == 1);
+        assert(_::findIndex(a, [](const int &item) -> bool { return item == 7; }) == _::NOT_FOUND);
+        assert(_::some(a, [](const int &item) -> bool { return item == 9; }));
+        assert(!_::every(a, [](const int &item) -> bool { return item < 9; }));
+        assert(_::chain(a).find([](const int &item) -> bool { return item > 4; }).value() == 5);
+        assert(_::chain(a).find([](const int &item) -> bool { return item > 9; }, -1).value() == -1);
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_scan() {
+
+        std::cout << "Testing scan..." << std::endl;
+
+        std::list<int> a{3, 1, 4, 1, 5};
+        auto plus = [](int memo, int item) -> int { return memo + item; };
+        assert((_::scan(a, plus, 0) == std::vector<int>{3, 4, 8, 9, 14}));
+        assert((_::exclusiveScan(a, plus, 0) == std::vector<int>{0, 3, 4, 8, 9}));
+        assert((_::chain(a).scan(plus, 10).value() == std::vector<int>{13, 14, 18, 19, 24}));
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_join() {
+
+        std::cout << "Testing join..." << std::endl;
+
+        //  (user, amount) events and (user, name) users
+        std::vector<std::pair<int, int>> events{{1, 10}, {2, 20}, {1, 30}, {4, 40}};
+        std::list<std::pair<int, std::string>> users{{1, "ann"}, {2, "bob"}, {3, "cid"}};
+        auto event_user = [](const std::pair<int, int> &event) -> int { return event.first; };
+        auto user_id = [](const std::pair<int, std::string> &user) -> int { return user.first; };
+
+        auto zipped = _::zip(events, users);
+        assert(zipped.size() == 3 && zipped[2].first.second == 30 && zipped[2].second.second == "cid");
+
+        auto joined = _::join(events, users, event_user, user_id);
+        assert(joined.size() == 3);
+        assert(joined[0].second.second == "ann" && joined[1].second.second == "bob");
+        assert(joined[2].first.second == 30 && joined[2].second.second == "ann");
+
+        auto left = _::chain(events).leftJoin(users, event_user, user_id, std::make_pair(0, std::string("-"))).value();
+        assert(left.size() == 4 && left[3].first.first == 4 && left[3].second.second == "-");
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_uniq() {
+
+        std::cout << "Testing uniq..." << std::endl;
+
+        std::list<int> a{3, 1, 3, 2, 1, 5};
+        assert((_::uniq(a) == std::list<int>{3, 1, 2, 5}));
+        auto parity = _::chain(a).uniqBy([](int item) -> int { return item % 2; }).value();
+        assert((parity == std::list<int>{3, 2}));
+
+        std::cout << "OK." << std::endl;
+    }
+
     void test_chain() {
 
         std::cout << "Testing chain..." << std::endl;
@@ -125,15 +328,154 @@ namespace test {
         std::cout << "OK." << std::endl;
     }
 
+    void test_move() {
+
+        std::cout << "Testing move chain..." << std::endl;
+
+        std::vector<int> a{1, 2, 3, 4, 5, 6, 7, 8};
+        const int *storage = a.data();
+        auto result = _::chain(std::move(a))
+                .filter([](const int &item) -> bool { return item % 2 == 0; })
+                .map<std::vector<int>>([](const int &item) -> int { return item * 10; })
+                .value();
+        assert((result == std::vector<int>{20, 40, 60, 80}));
+        assert(result.data() == storage);
+
+        std::list<int> l{5, 1, 4};
+        auto kept = _::filter(std::move(l), [](const int &item) -> bool { return item > 1; });
+        assert((kept == std::list<int>{5, 4}));
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_inplace() {
+
+        std::cout << "Testing in-place transform and filter..." << std::endl;
+
+        std::vector<int> a{1, 2, 3, 4, 5, 6, 7, 8};
+        const int *storage = a.data();
+        _::transform_inplace(a, [](const int &item) -> int { return item * 10; });
+        _::filter_inplace(a, [](const int &item) -> bool { return item % 20 == 0; });
+        assert((a == std::vector<int>{20, 40, 60, 80}));
+        assert(a.data() == storage);
+
+        std::list<int> l{5, 1, 4};
+        _::filter_inplace(l, [](const int &item) -> bool { return item > 1; });
+        assert((l == std::list<int>{5, 4}));
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_lazy() {
+
+        std::cout << "Testing lazy chain..." << std::endl;
+
+        std::vector<int> a{1, 2, 3, 4, 5, 6, 7, 8};
+        int seen = 0;
+        auto result = _::lazy(a)
+                .map<std::vector<long>>([](const int &item) -> long { return item * 10; })
+                .filter([](const long &item) -> bool { return item % 20 == 0; })
+                .each([&seen](const long &item) { seen++; })
+                .value();
+        assert(seen == 4);
+        assert((result == std::vector<long>{20, 40, 60, 80}));
+
+        auto groups = _::lazy(a)
+                .filter([](const int &item) -> bool { return item > 2; })
+                .group<int>([](const int &item) -> int { return item % 2; })
+                .value();
+        assert((groups[0] == std::vector<int>{4, 6, 8}));
+        assert((groups[1] == std::vector<int>{3, 5, 7}));
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_mapped_array() {
+
+        std::cout << "Testing mapped array..." << std::endl;
+
+        const char *path = "underscorepp_mapped_array.bin";
+        {
+            std::vector<int> a{3, 1, 4, 1, 5, 9, 2, 6};
+            std::ofstream out(path, std::ios::binary);
+            out.write(reinterpret_cast<const char *>(a.data()), a.size() * sizeof(int));
+            out.write("x", 1);
+        }
+        _::mapped_array<int> view(path);
+        assert(view.size() == 8 && view[5] == 9);
+        assert(_::sum(view) == 31 && _::max(view) == 9);
+        auto odd = _::filter(view, [](const int &item) -> bool { return item % 2 == 1; });
+        assert((odd == std::vector<int>{3, 1, 1, 5, 9}));
+        auto doubled = _::chain(view).map<std::vector<int>>([](const int &item) -> int { return item * 2; }).value();
+        assert(doubled.size() == 8 && doubled[7] == 12);
+        std::remove(path);
+
+        std::cout << "OK." << std::endl;
+    }
+
+    void test_stream() {
+
+        std::cout << "Testing stream..." << std::endl;
+
+        std::istringstream lines("3\n1\n4\n1\n5\n9\n2\n6\n");
+        auto sum = _::stream(lines)
+                .batch(3)
+                .map<std::vector<int>>([](const std::string &line) -> int { return std::stoi(line); })
+                .filter([](const int &item) -> bool { return item > 1; })
+                .reduce([](int memo, int item) -> int { return memo + item; }, 0)
+                .value();
+        assert(sum == 29);
+
+        //  one running result across batches, from an init that is not 0
+        std::vector<int> ten{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        auto count = _::stream(ten.begin(), ten.end()).batch(3)
+                .reduce([](int memo, int item) -> int { return memo + 1; }, 0)
+                .value();
+        assert(count == 10);
+        auto from100 = _::stream(ten.begin(), ten.end()).batch(3)
+                .reduce([](int memo, int item) -> int { return memo + item; }, 100)
+                .value();
+        assert(from100 == 155);
+
+        std::istringstream numbers("1 2 3 4 5 6");
+        auto odd = _::stream(std::istream_iterator<int>(numbers), std::istream_iterator<int>())
+                .filter([](const int &item) -> bool { return item % 2 == 1; })
+                .value();
+        assert((odd == std::vector<int>{1, 3, 5}));
+
+        int next = 0;
+        auto groups = _::stream<_::Serial, int>([&next](int &item) -> bool {
+            item = next++;
+            return item < 10;
+        }).batch(4).group<int>([](const int &item) -> int { return item % 3; }).value();
+        assert(groups.size() == 3 && (groups[0] == std::vector<int>{0, 3, 6, 9}));
+
+        std::cout << "OK." << std::endl;
+    }
+
     void test_underscore() {
 
         test_each();
         test_map();
         test_filter();
         test_group();
+        test_group_reduce();
         test_reduce();
+        test_numeric();
         test_flatten();
+        test_into();
+        test_arena();
+        test_sort();
+        test_search();
+        test_scan();
+        test_join();
+        test_uniq();
         test_chain();
+        test_move();
+        test_inplace();
+        test_lazy();
+        test_mapped_array();
+        test_stream();
     }
 }
 
@@ -176,6 +518,14 @@ namespace test {
                 assert(a2[i] == a[i] * 2);
             }
 
+            //  bits of a vector<bool> are written by one thread
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+            auto odd = _::parallel::map<std::vector<bool>>(a, [](const int &item) -> bool { return item % 2; });
+            for (size_t i = 0; i < odd.size(); i++) {
+                assert(odd[i] == (a[i] % 2 == 1));
+            }
+
             std::cout << "OK..." << std::endl;
         }
 
@@ -197,6 +547,15 @@ namespace test {
             }
             assert(a2.size() == n / 1000);
 
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+            auto a3 = _::parallel::filter(a, [](const int &item) -> bool {
+                return item % 3 != 0;
+            });
+            assert(a3 == _::filter(a, [](const int &item) -> bool {
+                return item % 3 != 0;
+            }));
+
             std::cout << "OK..." << std::endl;
         }
 
@@ -221,6 +580,151 @@ namespace test {
                 }, 0);
                 std::cout << count << " ";
             });
+            std::cout << std::endl;
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+            auto expected = _::group<int>(a, [](const int &item) -> int {
+                return item % 997;
+            });
+            auto ordered = _::parallel::group<int>(a, [](const int &item) -> int {
+                return item % 997;
+            });
+            assert(ordered == expected);
+            auto unordered = _::chain<_::Parallel>(a)
+                    .group<int, std::unordered_map>([](const int &item) -> int { return item % 997; })
+                    .value();
+            assert(unordered.size() == expected.size());
+            for (const auto &item : expected) {
+                assert(unordered[item.first] == item.second);
+            }
+
+            //  keys with operator< and no std::hash
+            auto pair_key = [](const int &item) -> std::pair<int, int> {
+                return std::make_pair(item % 7, item % 3);
+            };
+            auto pairs = _::chain<_::Parallel>(a).group<std::pair<int, int>>(pair_key).value();
+            assert((pairs.size() == 21 && pairs == _::group<std::pair<int, int>>(a, pair_key)));
+            assert((_::parallel::group<std::pair<int, int>>(a, pair_key) == pairs));
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_group_reduce() {
+            std::cout << "Testing parallel groupReduce..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            auto key = [](const int &item) -> int { return item % 1000; };
+            auto counts = _::parallel::countBy<int>(a, key);
+            assert(counts == _::countBy<int>(a, key));
+
+            auto value = [](const int &item) -> long long { return item; };
+            auto sums = _::chain<_::Parallel>(a).sumBy<int, std::unordered_map>(key, value).value();
+            auto expected = _::sumBy<int>(a, key, value);
+            assert(sums.size() == expected.size());
+            for (const auto &item : expected) {
+                assert(sums[item.first] == item.second);
+            }
+
+            auto maxes = _::parallel::groupReduce<int>(a, key, [](int memo, const int &item) -> int {
+                return std::max(memo, item);
+            }, 0);
+            for (const auto &item : maxes) {
+                assert(item.second == n - 1000 + (item.first == 0 ? 1000 : item.first));
+            }
+
+            //  a count is not its own combiner
+            auto tally = _::parallel::groupReduce<int>(a, key, [](size_t memo, const int &item) -> size_t {
+                return memo + 1;
+            }, (size_t) 0);
+            assert(tally == counts);
+
+            //  ordered maps split their keys by range, so keys need no std::hash
+            auto cell = [](const int &item) -> std::pair<int, int> { return std::make_pair(item % 7, item % 5); };
+            auto cells = _::parallel::countBy<std::pair<int, int>>(a, cell);
+            assert((cells == _::countBy<std::pair<int, int>>(a, cell)));
+            assert(cells.size() == 35);
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_reduce() {
+            std::cout << "Testing parallel reduce..." << std::endl;
+
+            long long n = 100000;
+            std::vector<long long> a;
+            for (long long i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+            auto sum = _::parallel::reduce(a, [](long long memo, long long item) -> long long {
+                return memo + item;
+            }, 0LL);
+            assert(sum == n * (n + 1) / 2);
+
+            std::list<std::string> words{"one", "two", "three", "four", "five"};
+            auto length = _::chain<_::Parallel>(words)
+                    .reduce([](size_t memo, const std::string &item) -> size_t { return memo + item.size(); },
+                            (size_t) 0,
+                            [](size_t left, size_t right) -> size_t { return left + right; })
+                    .value();
+            assert(length == 19);
+
+            //  a fold that is not its own combiner, and an init that is not
+            //  an identity, with the default pool and with three workers
+            auto count = [](int memo, long long item) -> int { return memo + 1; };
+            auto plus = [](long long memo, long long item) -> long long { return memo + item; };
+            assert(_::chain<_::Parallel>(a).reduce(count, 0).value() == n);
+            assert(_::parallel::reduce(a, plus, 100LL) == n * (n + 1) / 2 + 100);
+            {
+                _::parallel::thread_pool pool(3);
+                _::parallel::scoped_pool scope(pool);
+                assert(_::chain<_::Parallel>(a).reduce(count, 0).value() == n);
+                assert(_::parallel::reduce(a, plus, 100LL) == n * (n + 1) / 2 + 100);
+                assert(_::parallel::reduce(a, count, 0, std::plus<int>()) == n);
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_numeric() {
+            std::cout << "Testing parallel numeric kernels..." << std::endl;
+
+            int n = 100003;
+            std::vector<int> a;
+            std::vector<float> f;
+            for (int i = 0; i < n; i++) {
+                a.push_back(i - 50000);
+                f.push_back((float) (i % 7));
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            assert(_::parallel::sum(a) == _::sum(a));
+            assert(_::parallel::min(a) == -50000 && _::parallel::max(a) == 50002);
+            assert(_::parallel::min(f) == 0 && _::parallel::max(f) == 6);
+            assert(_::parallel::dot(a, a) == _::dot(a, a));
+            assert(_::parallel::reduce(a, std::plus<int>(), 0) == (int) _::sum(a));
+
+            auto tripled = _::parallel::map<std::vector<int>>(a, _::ops::multiply(3));
+            for (int i = 0; i < n; i++) {
+                assert(tripled[i] == a[i] * 3);
+            }
+
+            auto doubled = _::parallel::map<std::vector<float>>(f, _::ops::multiply(2));
+            for (int i = 0; i < n; i++) {
+                assert(doubled[i] == f[i] * 2);
+            }
+            auto fractions = _::parallel::map<std::vector<double>>(std::vector<double>(n, 0.25), _::ops::add(1));
+            assert(_::every(fractions, [](double item) -> bool { return item == 1.25; }));
 
             std::cout << "OK." << std::endl;
         }
@@ -240,6 +744,313 @@ namespace test {
                 std::cout << item << " ";
             }
             std::cout << std::endl;
+            assert(result.size() == 31 && result[8] == 1 && result[30] == 7);
+
+            //  one large inner vector among many small and empty ones
+            std::list<std::vector<int>> skewed;
+            skewed.push_back(std::vector<int>());
+            skewed.push_back(std::vector<int>(10000));
+            for (int i = 0; i < 100; i++) {
+                skewed.push_back(std::vector<int>((size_t) (i % 3)));
+            }
+            int next = 0;
+            for (auto &inner : skewed) {
+                for (auto &item : inner) {
+                    item = next++;
+                }
+            }
+            auto flat = _::parallel::flatten(skewed);
+            assert(flat.size() == (size_t) next);
+            for (int i = 0; i < next; i++) {
+                assert(flat[i] == i);
+            }
+
+            std::vector<int> buffer(next);
+            assert(_::parallel::flatten_into(skewed, buffer.data()) == buffer.data() + next);
+            assert(buffer == flat);
+
+            std::vector<std::vector<std::string>> words{{"a", "b"}, {}, {"c"}, {"d", "e", "f"}};
+            auto joined = _::parallel::flatten(words);
+            assert((joined == std::vector<std::string>{"a", "b", "c", "d", "e", "f"}));
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_into() {
+
+            std::cout << "Testing parallel output iterator sinks..." << std::endl;
+
+            int n = 100000;
+            std::list<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            std::vector<long long> buffer(n + 1, -1);
+            auto end = _::parallel::map_into(a, buffer.begin(), [](const int &item) -> long long { return item * 2LL; });
+            assert(end == buffer.begin() + n && buffer[n] == -1);
+            for (int i = 0; i < n; i++) {
+                assert(buffer[i] == 2LL * (i + 1));
+            }
+
+            end = _::parallel::filter_into(a, buffer.begin(), [](const int &item) -> bool { return item % 3 == 0; });
+            assert(end == buffer.begin() + n / 3);
+            for (int i = 0; i < n / 3; i++) {
+                assert(buffer[i] == 3LL * (i + 1));
+            }
+
+            std::list<std::vector<int>> nested;
+            for (int i = 0; i < 1000; i++) {
+                nested.push_back(std::vector<int>(i % 7, i));
+            }
+            std::vector<int> flat(_::reduce(nested, [](size_t memo, const std::vector<int> &item) -> size_t {
+                return memo + item.size();
+            }, (size_t) 0));
+            assert(_::parallel::flatten_into(nested, flat.data()) == flat.data() + flat.size());
+            assert(flat == _::flatten(nested));
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_arena() {
+
+            std::cout << "Testing parallel arena allocation..." << std::endl;
+
+            int n = 100000;
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+            _::arena arena;
+
+            for (int batch = 0; batch < 3; batch++) {
+                {
+                    _::scoped_arena scoped(arena);
+                    _::arena_vector<int> a;
+                    for (int i = 1; i <= n; i++) {
+                        a.push_back(i);
+                    }
+                    auto groups = _::parallel::group<int, _::arena_unordered_map>(a, [](const int &item) -> int {
+                        return item % 10;
+                    });
+                    assert(groups.size() == 10);
+                    for (const auto &group : groups) {
+                        assert(group.second.size() == (size_t) n / 10);
+                        assert(std::is_sorted(group.second.begin(), group.second.end()));
+                    }
+                    auto counts = _::parallel::countBy<int>(a, [](const int &item) -> int { return item % 7; });
+                    assert(counts.size() == 7 && counts[0] == (size_t) n / 7);
+
+                    auto evens = _::parallel::filter(a, [](const int &item) -> bool { return item % 2 == 0; });
+                    _::parallel::filter_inplace(evens, [](const int &item) -> bool { return item % 4 == 0; });
+                    assert(evens.size() == (size_t) n / 4 && evens.back() == n);
+                }
+                arena.release();
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_sort() {
+
+            std::cout << "Testing parallel sort..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            unsigned int seed = 1;
+            for (int i = 0; i < n; i++) {
+                seed = seed * 1103515245u + 12345u;
+                a.push_back((int) (seed >> 16) % 1000);
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            auto expected = a;
+            std::sort(expected.begin(), expected.end());
+            assert(_::parallel::sort(a) == expected);
+
+            //  items with equal keys keep their order
+            auto by_key = _::parallel::sortBy(a, [](const int &item) -> int { return item / 10; });
+            std::vector<int> stable = a;
+            std::stable_sort(stable.begin(), stable.end(), [](const int &left, const int &right) -> bool {
+                return left / 10 < right / 10;
+            });
+            assert(by_key == stable);
+
+            auto top = _::parallel::topK(a, 50);
+            assert(top.size() == 50);
+            assert(std::equal(top.begin(), top.end(), expected.rbegin()));
+
+            std::list<int> l(a.begin(), a.end());
+            auto descending = _::chain<_::Parallel>(l)
+                    .sort(std::greater<int>())
+                    .value();
+            assert(std::equal(descending.begin(), descending.end(), expected.rbegin()));
+
+            //  items need not be default constructible
+            struct ranked {
+                int rank;
+
+                explicit ranked(int rank) : rank(rank) {}
+            };
+            std::vector<ranked> ranks;
+            for (const auto &item : a) {
+                ranks.push_back(ranked(item));
+            }
+            auto by_rank = _::parallel::sort(ranks, [](const ranked &left, const ranked &right) -> bool {
+                return left.rank < right.rank;
+            });
+            for (int i = 0; i < n; i++) {
+                assert(by_rank[i].rank == expected[i]);
+            }
+
+            using kind = _::parallel::partitioner;
+            _::parallel::scoped_partitioner scoped(kind(kind::DYNAMIC, 777));
+            assert(_::chain<_::Parallel>(std::move(a)).stableSort().value() == expected);
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_search() {
+
+            std::cout << "Testing parallel search..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 0; i < n; i++) {
+                a.push_back(i);
+            }
+            std::list<int> l(a.begin(), a.end());
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            auto late = [](const int &item) -> bool { return item > 50000 && item % 777 == 0; };
+            assert(_::parallel::findIndex(a, late) == 50505);
+            assert(*_::parallel::find(l, late) == 50505);
+            assert(_::parallel::findIndex(l, [](const int &item) -> bool { return item < 0; }) == _::NOT_FOUND);
+            assert(_::parallel::find(a, [](const int &item) -> bool { return item < 0; }) == a.end());
+            assert(_::chain<_::Parallel>(a).findIndex([](const int &item) -> bool { return item % 1000 == 999; })
+                           .value() == 999);
+
+            //  a match in the first chunk cancels the others
+            std::atomic<int> calls{0};
+            assert(_::parallel::some(a, [&calls](const int &item) -> bool {
+                calls++;
+                return item < 10;
+            }));
+            assert(calls < n / 10);
+            calls = 0;
+            assert(_::parallel::findIndex(a, [&calls](const int &item) -> bool {
+                calls++;
+                return item % 3 == 2;
+            }) == 2);
+            assert(calls < n / 10);
+
+            assert(_::parallel::every(l, [](const int &item) -> bool { return item >= 0; }));
+            assert(!_::chain<_::Parallel>(a).every([n](const int &item) -> bool { return item != n - 1; }).value());
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_scan() {
+
+            std::cout << "Testing parallel scan..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i % 7);
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            auto plus = [](long long memo, int item) -> long long { return memo + item; };
+            auto inclusive = _::parallel::scan(a, plus, 0LL, std::plus<long long>());
+            auto exclusive = _::chain<_::Parallel>(a).exclusiveScan(plus, 0LL, std::plus<long long>()).value();
+            assert(inclusive == _::scan(a, plus, 0LL));
+            assert(exclusive == _::exclusiveScan(a, plus, 0LL));
+            assert(exclusive[0] == 0 && inclusive.back() == _::parallel::sum(a));
+
+            auto largest = _::parallel::scan(a, [](int memo, int item) -> int { return std::max(memo, item); }, 0);
+            assert(largest[0] == 1 && largest[5] == 6 && largest.back() == 6);
+
+            //  a count is not its own combiner
+            auto positions = _::parallel::scan(a, [](size_t memo, int item) -> size_t { return memo + 1; }, (size_t) 0);
+            assert(positions.size() == (size_t) n && positions.back() == (size_t) n);
+
+            //  offsets of many small inner vectors
+            std::list<std::vector<int>> nested;
+            for (int i = 0; i < n; i++) {
+                nested.push_back(std::vector<int>(i % 3, i));
+            }
+            auto flat = _::parallel::flatten(nested);
+            assert(flat.size() == (size_t) n - 1 && flat == _::flatten(nested));
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_join() {
+
+            std::cout << "Testing parallel join..." << std::endl;
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            //  both sides past the size where the hash table is partitioned
+            std::vector<int> events;
+            for (int i = 0; i < 100000; i++) {
+                events.push_back(i * 7 % 60000);
+            }
+            std::list<int> users;
+            for (int i = 0; i < 50000; i++) {
+                users.push_back(i);
+            }
+            users.push_back(7);
+            auto same = [](int item) -> int { return item; };
+
+            auto zipped = _::parallel::zip(events, users);
+            assert(zipped == _::zip(events, users));
+
+            //  the table is built on users, then on events
+            auto joined = _::parallel::join(events, users, same, same);
+            assert(joined == _::join(events, users, same, same));
+            auto reversed = _::chain<_::Parallel>(users).join(events, same, same).value();
+            assert(reversed == _::join(users, events, same, same));
+
+            auto left = _::parallel::leftJoin(events, users, same, same, -1);
+            assert(left == _::leftJoin(events, users, same, same, -1));
+            assert(left.size() > joined.size());
+            std::vector<int> few{70000, 7, 3, 7};
+            auto small = _::chain<_::Parallel>(few).leftJoin(events, same, same, -1).value();
+            assert(small == _::leftJoin(few, events, same, same, -1));
+            assert(small[0].second == -1 && small[1].first == 7);
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_uniq() {
+
+            std::cout << "Testing parallel uniq..." << std::endl;
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            std::vector<int> ids;
+            for (int i = 0; i < 100000; i++) {
+                ids.push_back(i * 7 % 30011);
+            }
+            auto unique = _::parallel::uniq(ids);
+            assert(unique.size() == 30011 && unique == _::uniq(ids));
+
+            std::vector<std::string> words{"b", "a", "b", "cc", "a", "dd", "e"};
+            auto by_length = _::chain<_::Parallel>(words)
+                    .uniqBy([](const std::string &word) -> size_t { return word.size(); })
+                    .value();
+            assert((by_length == std::vector<std::string>{"b", "cc"}));
 
             std::cout << "OK." << std::endl;
         }
@@ -262,6 +1073,135 @@ namespace test {
             std::cout << "OK." << std::endl;
         }
 
+        void test_move() {
+
+            std::cout << "Testing parallel move chain..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+            const int *storage = a.data();
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            auto result = _::chain<_::Parallel>(std::move(a))
+                    .filter([](const int &item) -> bool { return item % 3 == 0; })
+                    .map<std::vector<int>>([](const int &item) -> int { return item / 3; })
+                    .map<std::vector<int>>(_::ops::add(1))
+                    .value();
+            assert(result.data() == storage);
+            assert(result.size() == (size_t) n / 3);
+            for (int i = 0; i < n / 3; i++) {
+                assert(result[i] == i + 2);
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_inplace() {
+
+            std::cout << "Testing parallel in-place transform and filter..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            std::list<int> l;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+                l.push_back(i);
+            }
+            const int *storage = a.data();
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            _::parallel::transform_inplace(a, [](const int &item) -> int { return item * 2; });
+            _::parallel::filter_inplace(a, [](const int &item) -> bool { return item % 3 == 0; });
+            assert(a.data() == storage);
+            assert(a.size() == (size_t) n / 3);
+            for (int i = 0; i < n / 3; i++) {
+                assert(a[i] == (i + 1) * 6);
+            }
+
+            _::parallel::transform_inplace(l, [](const int &item) -> int { return item - 1; });
+            _::parallel::filter_inplace(l, [](const int &item) -> bool { return item % 2 == 0; });
+            assert(l.size() == (size_t) n / 2);
+            int expected = 0;
+            for (const auto &item : l) {
+                assert(item == expected);
+                expected += 2;
+            }
+
+            //  runs of owning values move down through scratch storage
+            std::vector<std::string> words;
+            for (int i = 0; i < n; i++) {
+                words.push_back(std::to_string(i));
+            }
+            _::parallel::filter_inplace(words, [](const std::string &item) -> bool { return item.back() == '7'; });
+            assert(words.size() == (size_t) n / 10);
+            for (int i = 0; i < n / 10; i++) {
+                assert(words[i] == std::to_string(i * 10 + 7));
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_lazy() {
+
+            std::cout << "Testing parallel lazy chain..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            std::atomic<int> seen{0};
+            auto odd = _::lazy<_::Parallel>(a)
+                    .filter([](const int &item) -> bool { return item % 2 == 1; })
+                    .each([&seen](const int &item) { seen++; })
+                    .map<std::vector<long long>>([](const int &item) -> long long { return item * 3LL; })
+                    .value();
+            assert(seen == n / 2);
+            assert(odd.size() == (size_t) n / 2);
+            for (size_t i = 0; i < odd.size(); i++) {
+                assert(odd[i] == (2 * (long long) i + 1) * 3);
+            }
+
+            auto sum = _::lazy<_::Parallel>(a)
+                    .map<std::vector<long long>>([](const int &item) -> long long { return item; })
+                    .reduce([](long long memo, long long item) -> long long { return memo + item; }, 0LL)
+                    .value();
+            assert(sum == (long long) n * (n + 1) / 2);
+
+            //  a fold that is not its own combiner, from a non-zero init
+            auto count = _::lazy<_::Parallel>(a)
+                    .filter([](const int &item) -> bool { return item % 2 == 0; })
+                    .reduce([](int memo, int item) -> int { return memo + 1; }, 10)
+                    .value();
+            assert(count == n / 2 + 10);
+            auto combined = _::lazy<_::Parallel>(a)
+                    .reduce([](int memo, int item) -> int { return memo + 1; }, 0, std::plus<int>())
+                    .value();
+            assert(combined == n);
+
+            auto groups = _::lazy<_::Parallel>(a)
+                    .group<int>([](const int &item) -> int { return item % 10; })
+                    .value();
+            assert(groups.size() == 10);
+            for (const auto &group : groups) {
+                assert(group.second.size() == (size_t) n / 10);
+                assert(std::is_sorted(group.second.begin(), group.second.end()));
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
         void test_parallel_each_for_map() {
             std::cout << "Testing parallel each for map..." << std::endl;
 
@@ -282,14 +1222,392 @@ namespace test {
             std::cout << "OK." << std::endl;
         }
 
+        void test_parallel_map_for_list() {
+            std::cout << "Testing parallel map for list..." << std::endl;
+
+            const int n = 1000000;
+            std::list<int> l;
+            for (int i = 0; i < n; i++) {
+                l.push_back(i);
+            }
+            auto v = _::parallel::map<std::vector<int>>(l, [](const int &item) -> int {
+                return item + 1;
+            });
+
+            assert(v.size() == n);
+            for (int i = 0; i < n; i++) {
+                assert(v[i] == i + 1);
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_partitioner() {
+            std::cout << "Testing parallel partitioner..." << std::endl;
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            //  tiny inputs stay on the calling thread
+            std::vector<int> small{1, 2, 3, 4, 5, 6};
+            auto caller = std::this_thread::get_id();
+            _::parallel::each(small, [&caller](const int &item) {
+                assert(std::this_thread::get_id() == caller);
+            });
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+            auto expected = _::filter(a, [](const int &item) -> bool { return item % 7 == 0; });
+            using kind = _::parallel::partitioner;
+
+            //  a grain of 100 runs a small input on the workers too
+            {
+                _::parallel::scoped_partitioner scoped(kind(kind::AUTO, 100));
+                std::vector<int> few(a.begin(), a.begin() + 4000);
+                std::atomic<int> elsewhere{0};
+                _::parallel::each(few, [&caller, &elsewhere](const int &item) {
+                    if (std::this_thread::get_id() != caller) {
+                        elsewhere++;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(10));
+                });
+                assert(elsewhere > 0);
+            }
+            assert(kind(kind::AUTO, 100).chunks(4000, 4) == 16 && kind().chunks(4000, 4) == 1);
+            size_t dynamic = kind(kind::DYNAMIC).chunks(n, 4);
+            assert(dynamic >= 64 && dynamic <= 65 && kind(kind::DYNAMIC, 1000).chunks(n, 4) == 100);
+
+            for (auto partitioner : {kind(kind::STATIC), kind(kind::DYNAMIC, 1000), kind(kind::AUTO, 1, 0)}) {
+                _::parallel::scoped_partitioner scoped(partitioner);
+                assert(_::parallel::filter(a, [](const int &item) -> bool { return item % 7 == 0; }) == expected);
+                assert(_::parallel::sum(a) == (long long) n * (n + 1) / 2);
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_context() {
+            std::cout << "Testing parallel context..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+
+            auto nodes = _::parallel::numa_nodes();
+            assert(!nodes.empty() && !nodes[0].empty());
+            assert((_::parallel::_parse_cpu_list("0-2,5") == std::vector<int>{0, 1, 2, 5}));
+
+            _::parallel::context ctx(4, nodes[0]);
+            assert(ctx.concurrency() == 4);
+
+            using buffer_type = std::vector<int, _::default_init_allocator<int>>;
+            auto doubled = _::parallel::map<buffer_type>(ctx, a, [](const int &item) -> int { return item * 2; });
+            for (int i = 0; i < n; i++) {
+                assert(doubled[i] == a[i] * 2);
+            }
+            auto sum = _::parallel::reduce(ctx, a, [](long long memo, long long item) -> long long {
+                return memo + item;
+            }, 0LL);
+            assert(sum == (long long) n * (n + 1) / 2);
+            auto total = _::parallel::reduce(ctx, a, [](long long memo, long long item) -> long long {
+                return memo + item;
+            }, 0LL, [](long long left, long long right) -> long long {
+                assert(_::parallel::get_concurrency() == 4);
+                return left + right;
+            });
+            assert(total == sum);
+
+            auto evens = _::chain<_::Parallel>(a, ctx)
+                    .filter([](const int &item) -> bool {
+                        assert(_::parallel::get_concurrency() == 4);
+                        return item % 2 == 0;
+                    })
+                    .value();
+            assert(evens.size() == (size_t) n / 2);
+            assert(_::parallel::get_concurrency() == _::parallel::default_pool().size() + 1);
+
+            //  the calling thread is pinned while it works on a pinned context
+            auto before = _::parallel::get_affinity();
+            {
+                _::parallel::scoped_context scoped(ctx);
+                for (int cpu : _::parallel::get_affinity()) {
+                    assert(std::find(nodes[0].begin(), nodes[0].end(), cpu) != nodes[0].end());
+                }
+            }
+            assert(_::parallel::get_affinity() == before);
+
+            auto contexts = _::parallel::numa_contexts();
+            assert(contexts.size() == nodes.size());
+            for (size_t node = 0; node < nodes.size(); node++) {
+                assert(contexts[node].concurrency() == nodes[node].size());
+                assert(contexts[node].cpus() == nodes[node]);
+                auto odd = _::parallel::filter(contexts[node], a, [](const int &item) -> bool { return item % 2; });
+                assert(odd.size() == (size_t) n / 2);
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_thread_pool() {
+            std::cout << "Testing parallel thread pool..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+
+            _::parallel::thread_pool pool(4);
+            std::vector<std::thread> callers;
+            for (int t = 0; t < 4; t++) {
+                callers.emplace_back([&a, &pool, n]() {
+                    _::parallel::scoped_pool scope(pool);
+                    assert(_::parallel::get_concurrency() == 5);
+                    for (int k = 0; k < 20; k++) {
+                        auto a2 = _::chain<_::Parallel>(a)
+                                .map<std::vector<int>>([](const int &item) -> int { return item * 2; })
+                                .value();
+                        assert(a2.size() == a.size());
+                        for (int i = 0; i < n; i++) {
+                            assert(a2[i] == a[i] * 2);
+                        }
+                    }
+                });
+            }
+            for (auto &caller : callers) {
+                caller.join();
+            }
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_mapped_array() {
+
+            std::cout << "Testing parallel mapped array..." << std::endl;
+
+            int n = 100000;
+            const char *path = "underscorepp_mapped_array.bin";
+            {
+                std::vector<int> a;
+                for (int i = 1; i <= n; i++) {
+                    a.push_back(i);
+                }
+                std::ofstream out(path, std::ios::binary);
+                out.write(reinterpret_cast<const char *>(a.data()), a.size() * sizeof(int));
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            _::mapped_array<int> view(path, _::mapped_array<int>::WILLNEED);
+            assert(view.size() == (size_t) n);
+            const size_t page = _::mapped_array<int>::page_size();
+            size_t covered = 0;
+            for (const auto &chunk : _::parallel::_split(view)) {
+                assert(chunk.idx == covered && chunk.idx * sizeof(int) % page == 0);
+                covered += chunk.last - chunk.first;
+            }
+            assert(covered == (size_t) n);
+
+            assert(_::parallel::sum(view) == (long long) n * (n + 1) / 2);
+            assert(_::parallel::min(view) == 1 && _::parallel::max(view) == n);
+            auto evens = _::chain<_::Parallel>(view)
+                    .filter([](const int &item) -> bool { return item % 2 == 0; })
+                    .map<std::vector<int>>([](const int &item) -> int { return item / 2; })
+                    .value();
+            assert(evens.size() == (size_t) n / 2);
+            for (int i = 0; i < n / 2; i++) {
+                assert(evens[i] == i + 1);
+            }
+            auto groups = _::parallel::group<int>(view, [](const int &item) -> int { return item % 10; });
+            assert(groups.size() == 10 && groups[0].size() == (size_t) n / 10);
+            auto count = _::lazy<_::Parallel>(view)
+                    .filter([](const int &item) -> bool { return item % 3 == 0; })
+                    .value();
+            assert(count.size() == (size_t) n / 3);
+            std::remove(path);
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_stream() {
+
+            std::cout << "Testing parallel stream..." << std::endl;
+
+            int n = 100000;
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            int next = 1;
+            auto generator = [&next, n](long long &item) -> bool {
+                item = next++;
+                return item <= n;
+            };
+            auto sum = _::stream<_::Parallel, long long>(generator)
+                    .batch(10000)
+                    .filter([](const long long &item) -> bool { return item % 2 == 0; })
+                    .reduce([](long long memo, long long item) -> long long { return memo + item; }, 0LL)
+                    .value();
+            assert(sum == (long long) n / 2 * (n / 2 + 1));
+
+            next = 1;
+            auto count = _::stream<_::Parallel, long long>(generator)
+                    .batch(10000)
+                    .reduce([](long long memo, long long item) -> long long { return memo + 1; }, 5LL)
+                    .value();
+            assert(count == n + 5);
+            next = 1;
+            auto combined = _::stream<_::Parallel, long long>(generator)
+                    .batch(10000)
+                    .reduce([](long long memo, long long item) -> long long { return memo + 1; }, 0LL,
+                            std::plus<long long>())
+                    .value();
+            assert(combined == n);
+
+            std::ostringstream out;
+            for (int i = 0; i < n; i++) {
+                out << i << "\n";
+            }
+            std::istringstream in(out.str());
+            auto groups = _::stream<_::Parallel>(in)
+                    .memory(64 * 1024)
+                    .map<std::vector<int>>([](const std::string &line) -> int { return std::stoi(line); })
+                    .group<int>([](const int &item) -> int { return item % 10; })
+                    .value();
+            assert(groups.size() == 10);
+            for (const auto &group : groups) {
+                assert(group.second.size() == (size_t) n / 10);
+                assert(std::is_sorted(group.second.begin(), group.second.end()));
+            }
+
+            //  no more than one batch is read ahead of the steps
+            int read = 0;
+            int buffered = 0;
+            std::atomic<int> processed{0};
+            _::stream<_::Parallel, int>([&read, &buffered, &processed, n](int &item) -> bool {
+                buffered = std::max(buffered, read - processed.load());
+                item = read++;
+                return item < n;
+            }).batch(5000).each([&processed](const int &item) { processed++; }).run();
+            assert(processed == n && buffered <= 5000);
+
+            std::cout << "OK." << std::endl;
+        }
+
+        void test_async() {
+
+            std::cout << "Testing parallel async..." << std::endl;
+
+            int n = 100000;
+            std::vector<int> a;
+            for (int i = 1; i <= n; i++) {
+                a.push_back(i);
+            }
+
+            _::parallel::thread_pool pool(3);
+            _::parallel::scoped_pool scope(pool);
+
+            auto doubled = _::async::map<std::vector<int>>(a, [](const int &item) -> int { return item * 2; });
+            auto evens = _::async::filter(a, [](const int &item) -> bool { return item % 2 == 0; });
+            auto groups = _::async::group<int>(a, [](const int &item) -> int { return item % 10; });
+            auto sum = _::async::reduce(a, [](long long memo, long long item) -> long long {
+                return memo + item;
+            }, 0LL);
+            assert(doubled.get()[n - 1] == 2 * n);
+            assert(evens.get().size() == (size_t) n / 2);
+            assert(groups.get().size() == 10);
+            assert(sum.get() == (long long) n * (n + 1) / 2);
+
+            //  independent chains run at the same time on the pool
+            std::vector<std::future<long long>> chains;
+            for (int k = 1; k <= 4; k++) {
+                chains.push_back(_::async::chain<_::Parallel>(a)
+                                         .filter([k](const int &item) -> bool { return item % k == 0; })
+                                         .map<std::vector<long long>>([](const int &item) -> long long { return item; })
+                                         .reduce([](long long memo, long long item) -> long long {
+                                             return memo + item;
+                                         }, 0LL)
+                                         .value());
+            }
+            for (int k = 1; k <= 4; k++) {
+                long long m = n / k;
+                assert(chains[k - 1].get() == k * m * (m + 1) / 2);
+            }
+
+            int next = 1;
+            auto streamed = _::stream<_::Parallel, long long>([&next, n](long long &item) -> bool {
+                item = next++;
+                return item <= n;
+            }).batch(1000).pipeline().reduce([](long long memo, long long item) -> long long {
+                return memo + item;
+            }, 0LL).value();
+            assert(streamed == (long long) n * (n + 1) / 2);
+
+            //  a pipelined stream on the only worker of a pool consumes its
+            //  batches itself instead of waiting for a task queued behind it
+            {
+                _::parallel::thread_pool one(1);
+                _::parallel::scoped_pool single(one);
+                std::vector<int> seed{n};
+                auto nested = _::async::map<std::vector<long long>>(seed, [](const int &count) -> long long {
+                    int next = 1;
+                    return _::stream<_::Parallel, int>([&next, count](int &item) -> bool {
+                        item = next++;
+                        return item <= count;
+                    }).batch(1000).pipeline().reduce([](long long memo, long long item) -> long long {
+                        return memo + item;
+                    }, 0LL, std::plus<long long>()).value();
+                });
+                assert(nested.get()[0] == (long long) n * (n + 1) / 2);
+            }
+
+            //  a pool without workers runs the task on the calling thread
+            _::parallel::thread_pool empty(0);
+            _::parallel::scoped_pool none(empty);
+            auto caller = std::this_thread::get_id();
+            std::vector<int> once{1};
+            auto where = _::async::map<std::vector<std::thread::id>>(once, [](const int &item) {
+                return std::this_thread::get_id();
+            });
+            assert(where.get()[0] == caller);
+            assert(_::async::chain(std::move(a)).map<std::vector<int>>(_::ops::add(1)).value().get()[0] == 2);
+
+            std::cout << "OK." << std::endl;
+        }
+
         void test_parallel_underscore() {
             test_each();
             test_map();
             test_filter();
             test_group();
+            test_group_reduce();
+            test_reduce();
+            test_numeric();
             test_flatten();
+            test_into();
+            test_arena();
+            test_sort();
+            test_search();
+            test_scan();
+            test_join();
+            test_uniq();
             test_chain();
+            test_move();
+            test_inplace();
+            test_lazy();
+            test_mapped_array();
+            test_stream();
+            test_async();
             test_parallel_each_for_map();
+            test_parallel_map_for_list();
+            test_partitioner();
+            test_context();
+            test_thread_pool();
         }
 
     }